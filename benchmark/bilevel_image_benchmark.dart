@@ -0,0 +1,37 @@
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as pw;
+
+// Embeds every PNG of the directory named by HTMLTOPDF_SCAN_CORPUS with and
+// without bilevel snapping, and prints PDF bytes and time for each. Run with
+// `flutter test benchmark/bilevel_image_benchmark.dart` once it is set.
+void main() {
+  final corpus = Platform.environment['HTMLTOPDF_SCAN_CORPUS'];
+
+  Future<int> embed(String label, pw.HtmlImageOptimizer optimizer) async {
+    final files = Directory(corpus!)
+        .listSync()
+        .whereType<File>()
+        .where((file) => file.path.toLowerCase().endsWith('.png'));
+    var bytes = 0;
+    final watch = Stopwatch()..start();
+    for (final file in files) {
+      final image =
+          await optimizer.optimize(pw.MemoryImage(file.readAsBytesSync()));
+      final document = pw.Document();
+      document.addPage(pw.Page(build: (context) => pw.Image(image)));
+      bytes += (await document.save()).length;
+    }
+    stdout.writeln('$label: $bytes bytes, ${watch.elapsedMilliseconds} ms');
+    return bytes;
+  }
+
+  test('scanned pages', () async {
+    final rgb = await embed('rgb', const pw.HtmlImageOptimizer());
+    final bilevel = await embed(
+        'bilevel', const pw.HtmlImageOptimizer(bilevelThreshold: 128));
+    expect(bilevel, lessThanOrEqualTo(rgb));
+  }, skip: corpus == null ? 'HTMLTOPDF_SCAN_CORPUS is not set' : false,
+      timeout: Timeout.none);
+}
@@ -0,0 +1,38 @@
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as pw;
+
+// Renders a code appendix of 20000 lines through the fixed-grid fast path
+// and through the widget path. Run with `flutter test benchmark`.
+void main() {
+  final html = StringBuffer();
+  for (var i = 0; i < 100; i++) {
+    html.write('<h3>Listing ${i + 1}</h3><pre><code>');
+    for (var j = 0; j < 200; j++) {
+      html.write('  if (value &lt; limit) {\n'
+          '\treturn compute(value, offset: $j);  // line $j\n');
+    }
+    html.write('</code></pre>');
+  }
+
+  test('code fast path, 20000 lines', () async {
+    final watch = Stopwatch()..start();
+    final bytes = await pw.HTMLToPdf()
+        .convertText(html.toString(), maxPages: 5000);
+    expect(bytes, isNotEmpty);
+    stdout.writeln('direct: ${watch.elapsedMilliseconds} ms, '
+        '${bytes.length} bytes');
+  }, timeout: Timeout.none);
+
+  test('code widget path, 20000 lines', () async {
+    final watch = Stopwatch()..start();
+    final widgets = await pw.HTMLToPdf().convert(html.toString());
+    final document = pw.Document();
+    document.addPage(pw.MultiPage(maxPages: 5000, build: (context) => widgets));
+    final bytes = await document.save();
+    expect(document.document.pdfPageList.pages.length, greaterThan(100));
+    stdout.writeln('widgets: ${watch.elapsedMilliseconds} ms, '
+        '${bytes.length} bytes');
+  }, timeout: Timeout.none);
+}
@@ -0,0 +1,36 @@
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as pw;
+
+// Content stream size and save time per page for text made of many short
+// styled runs. Run with `flutter test benchmark/content_stream_benchmark.dart`.
+void main() {
+  final paragraph = StringBuffer('<p>');
+  for (var i = 0; i < 40; i++) {
+    paragraph.write('plain words <b>bold words</b> <i>italic</i> '
+        '<span style="color: rgb(0, 105, 255)">coloured</span> ');
+  }
+  paragraph.write('</p>');
+  final html = List.filled(100, paragraph.toString()).join();
+
+  test('widget path, uncompressed', () async {
+    final widgets = await pw.HTMLToPdf().convert(html);
+    final document = pw.Document(compress: false);
+    document.addPage(pw.MultiPage(maxPages: 1000, build: (context) => widgets));
+    final watch = Stopwatch()..start();
+    final bytes = await document.save();
+    final pages = document.document.pdfPageList.pages.length;
+    expect(pages, greaterThan(1));
+    stdout.writeln('widgets: ${bytes.length ~/ pages} bytes/page, '
+        '${watch.elapsedMicroseconds / 1000 / pages} ms/page to save');
+  }, timeout: Timeout.none);
+
+  test('text writer', () async {
+    final watch = Stopwatch()..start();
+    final bytes = await pw.HTMLToPdf().convertText(html, maxPages: 1000);
+    expect(bytes, isNotEmpty);
+    stdout.writeln('direct: ${bytes.length} bytes, '
+        '${watch.elapsedMilliseconds} ms');
+  }, timeout: Timeout.none);
+}
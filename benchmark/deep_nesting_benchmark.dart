@@ -0,0 +1,37 @@
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as pw;
+
+// Converts markup nested 10,000 levels deep, as produced by broken editors.
+// Run with `flutter test benchmark`.
+void main() {
+  const depth = 10000;
+  final html = '<p>${'<span><b>' * (depth ~/ 2)}deep'
+      '${'</b></span>' * (depth ~/ 2)}</p>';
+  final divs = '${'<div>' * depth}deep${'</div>' * depth}';
+
+  test('widget path, $depth levels', () async {
+    final watch = Stopwatch()..start();
+    final widgets = await pw.HTMLToPdf().convert(html);
+    expect(widgets, isNotEmpty);
+    stdout.writeln('widgets: ${watch.elapsedMilliseconds} ms, '
+        '${widgets.length} blocks');
+  }, timeout: Timeout.none);
+
+  test('text fast path, $depth levels', () async {
+    final watch = Stopwatch()..start();
+    final bytes = await pw.HTMLToPdf().convertText(html);
+    expect(bytes, isNotEmpty);
+    stdout.writeln('direct: ${watch.elapsedMilliseconds} ms, '
+        '${bytes.length} bytes');
+  }, timeout: Timeout.none);
+
+  test('text fast path, $depth nested divs', () async {
+    final watch = Stopwatch()..start();
+    final bytes = await pw.HTMLToPdf().convertText(divs);
+    expect(bytes, isNotEmpty);
+    stdout.writeln('divs: ${watch.elapsedMilliseconds} ms, '
+        '${bytes.length} bytes');
+  }, timeout: Timeout.none);
+}
@@ -0,0 +1,26 @@
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as pw;
+
+// Time to the first conversion in a fresh process, where fonts, the parser
+// and the layout cache are all cold, against a second, warm one. Run with
+// `flutter test benchmark/startup_benchmark.dart`. For the whole app,
+// including engine start, run the example with `--startup-benchmark` and
+// HTMLTOPDF_STARTUP_TRACE=1.
+void main() {
+  const html = '<h1>Invoice</h1><p>Thank you for your <b>order</b>.</p>'
+      '<ul><li>First item</li><li>Second item</li></ul>';
+
+  test('first and second conversion', () async {
+    final watch = Stopwatch()..start();
+    final cold = await const pw.HTMLToPdf().convertText(html);
+    final first = watch.elapsedMicroseconds;
+    watch.reset();
+    final warm = await const pw.HTMLToPdf().convertText(html);
+    final second = watch.elapsedMicroseconds;
+    expect(cold, isNotEmpty);
+    expect(warm, isNotEmpty);
+    stdout.writeln('first: ${first / 1000} ms, second: ${second / 1000} ms');
+  }, timeout: Timeout.none);
+}
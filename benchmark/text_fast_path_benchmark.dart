@@ -0,0 +1,56 @@
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as pw;
+
+// Compares the direct text writer with the widget path on a document of
+// about a thousand pages. Run with `flutter test benchmark`.
+void main() {
+  final paragraph = '<p>Lorem ipsum dolor sit amet, <b>consectetur</b> '
+      'adipiscing elit, sed do <i>eiusmod tempor</i> incididunt ut labore '
+      'et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud '
+      'exercitation ullamco laboris nisi ut aliquip ex ea commodo.</p>';
+  final html = StringBuffer();
+  for (var i = 0; i < 1000; i++) {
+    html.write('<h2>Section ${i + 1}</h2>');
+    for (var j = 0; j < 8; j++) {
+      html.write(paragraph);
+    }
+    html.write('<ul><li>First item</li><li>Second item</li></ul>');
+  }
+
+  test('text fast path, 1000 pages', () async {
+    final watch = Stopwatch()..start();
+    final bytes = await pw.HTMLToPdf()
+        .convertText(html.toString(), maxPages: 5000);
+    expect(bytes, isNotEmpty);
+    stdout.writeln('direct: ${watch.elapsedMilliseconds} ms, '
+        '${bytes.length} bytes');
+  }, timeout: Timeout.none);
+
+  // Background writes start from an empty layout cache on a new isolate,
+  // foreground writes keep theirs between documents.
+  test('text fast path, 1000 pages, foreground vs background', () async {
+    for (final background in [false, true]) {
+      final watch = Stopwatch()..start();
+      for (var i = 0; i < 3; i++) {
+        final bytes = await pw.HTMLToPdf().convertText(html.toString(),
+            maxPages: 5000, background: background);
+        expect(bytes, isNotEmpty);
+      }
+      final mode = background ? 'background' : 'foreground';
+      stdout.writeln('$mode, 3 documents: ${watch.elapsedMilliseconds} ms');
+    }
+  }, timeout: Timeout.none);
+
+  test('widget path, 1000 pages', () async {
+    final watch = Stopwatch()..start();
+    final widgets = await pw.HTMLToPdf().convert(html.toString());
+    final document = pw.Document();
+    document.addPage(pw.MultiPage(maxPages: 5000, build: (context) => widgets));
+    final bytes = await document.save();
+    expect(document.document.pdfPageList.pages.length, greaterThan(500));
+    stdout.writeln('widgets: ${watch.elapsedMilliseconds} ms, '
+        '${bytes.length} bytes');
+  }, timeout: Timeout.none);
+}
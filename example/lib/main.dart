@@ -1,10 +1,22 @@
+import 'dart:async';
 import 'dart:io';
 import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as htmltopdfwidgets;
 import 'package:flutter/material.dart';
+import 'package:flutter/services.dart';
 import 'package:path_provider/path_provider.dart';
 
-void main() {
+void main(List<String> args) {
+  final startup = Stopwatch()..start();
   runApp(const MyApp());
+  if (args.contains('--startup-benchmark')) {
+    // Time from Dart entry to the first finished conversion, then quit.
+    htmltopdfwidgets.HTMLToPdf()
+        .convertText('<h1>Startup</h1><p>First conversion.</p>')
+        .then((bytes) {
+      stdout.writeln('first conversion: ${startup.elapsedMilliseconds} ms');
+      exit(0);
+    });
+  }
 }
 
 class MyApp extends StatelessWidget {
@@ -40,7 +52,37 @@ class MyHomePage extends StatefulWidget {
   State<MyHomePage> createState() => _MyHomePageState();
 }
 
-class _MyHomePageState extends State<MyHomePage> {
+class _MyHomePageState extends State<MyHomePage>
+    with WidgetsBindingObserver {
+  // Served in the Prometheus text format by the Linux runner.
+  static const metricsChannel =
+      BasicMessageChannel<String>('htmltopdfwidgets/metrics', StringCodec());
+  Timer? metricsTimer;
+
+  @override
+  void initState() {
+    super.initState();
+    WidgetsBinding.instance.addObserver(this);
+    if (Platform.isLinux) {
+      metricsTimer = Timer.periodic(const Duration(seconds: 5), (_) {
+        metricsChannel.send(
+            htmltopdfwidgets.ConversionMetrics.instance.toPrometheus());
+      });
+    }
+  }
+
+  @override
+  void dispose() {
+    WidgetsBinding.instance.removeObserver(this);
+    metricsTimer?.cancel();
+    super.dispose();
+  }
+
+  @override
+  void didHaveMemoryPressure() {
+    htmltopdfwidgets.HtmlMemoryPressure.instance.shrink();
+  }
+
   final htmlText =
       '''<h3>Tutorial Series:&nbsp;How To Build a Website with HTML</h3><p>This tutorial series will guide you through creating and further customizing&nbsp;<a href="http://html.sammy-codes.com/" rel="noopener noreferrer" target="_blank" style="color: rgb(0, 105, 255); background-color: transparent;"><strong><em><u>this website</u></em></strong></a><strong><em><u>&nbsp;</u></em></strong>using HTML, the standard markup language used to display documents in a web browser. No prior coding experience is necessary but we recommend you start at the&nbsp;<a href="https://www.digitalocean.com/community/tutorial_series/how-to-build-a-website-with-html" rel="noopener noreferrer" target="_blank" style="color: rgb(0, 105, 255); background-color: transparent;">beginning of the series</a>&nbsp;if you wish to recreate the demonstration website.</p><p>At the end of this series, you should have a website ready to deploy to the cloud and a basic familiarity with HTML. Knowing how to write HTML will provide a strong foundation for learning additional front-end web development skills, such as CSS and JavaScript.</p><p>Subscribe<a href="https://www.digitalocean.com/community/tags/html" rel="noopener noreferrer" target="_blank" style="color: rgb(77, 91, 124); background-color: rgb(239, 242, 251);">HTML</a></p><p><a href="https://www.digitalocean.com/community/tags/spin-up" rel="noopener noreferrer" target="_blank" style="color: rgb(77, 91, 124); background-color: rgb(239, 242, 251);">Spin Up</a></p><p>Browse Series: 23 articles</p><ul><li><a href="https://www.digitalocean.com/community/tutorials/how-to-set-up-your-html-project" rel="noopener noreferrer" target="_blank" style="color: rgb(138, 150, 181); background-color: transparent;">1/23 How To Set Up Your HTML Project With VS Code</a></li><li><a href="https://www.digitalocean.com/community/tutorials/how-to-view-the-source-code-of-an-html-document" rel="noopener noreferrer" target="_blank" style="color: rgb(138, 150, 181); background-color: transparent;">2/23 How To View the Source Code of an HTML Document</a></li><li><a href="https://www.digitalocean.com/community/tutorials/how-to-use-and-understand-html-elements" rel="noopener noreferrer" target="_blank" style="color: rgb(138, 150, 181); background-color: transparent;">3/23 How To Use and Understand HTML Elements</a></li></ul><p><span style="color: rgb(206, 145, 120);"><img src="https://developer.mozilla.org/en-US/docs/Learn/HTML/Multimedia_and_embedding/Images_in_HTML/image-with-title.png" alt="The dinosaur image, with a tooltip title on top of it that reads A T-Rex on display at the Manchester University Museum " height="341" width="400"></span></p>"''';
 
@@ -70,16 +112,13 @@ class _MyHomePageState extends State<MyHomePage> {
   createDocument() async {
     var directory = await getApplicationDocumentsDirectory();
     var filePath = '${directory.path}/example.pdf';
-    var file = File(filePath);
-    final newpdf = htmltopdfwidgets.Document();
-    List<htmltopdfwidgets.Widget> widgets =
-        await htmltopdfwidgets.HTMLToPdf().convert(htmlText);
-    newpdf.addPage(htmltopdfwidgets.MultiPage(
-        maxPages: 200,
-        build: (context) {
-          return widgets;
-        }));
-    await file.writeAsBytes(await newpdf.save());
-    print('File created: $filePath');
+    var sink = File(filePath).openWrite();
+    try {
+      await htmltopdfwidgets.HTMLToPdf()
+          .render(htmlText, sink, maxPages: 200);
+    } finally {
+      await sink.close();
+    }
+    debugPrint('File created: $filePath');
   }
 }
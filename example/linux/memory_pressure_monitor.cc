@@ -0,0 +1,181 @@
+#include "memory_pressure_monitor.h"
+
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <string.h>
+#include <unistd.h>
+
+// Some task stalled on memory for 150ms within a 2s window. Unprivileged
+// processes may only use windows that are multiples of 2s.
+static constexpr char kPsiTrigger[] = "some 150000 2000000";
+
+// Applies to both sources, so one bad moment sends one message.
+static constexpr gint64 kMinIntervalUs = G_USEC_PER_SEC;
+
+struct _MemoryPressureMonitor {
+  GObject parent_instance;
+  FlBasicMessageChannel* channel;
+
+  int psi_fd;
+  guint psi_source;
+
+  GFileMonitor* events_monitor;
+  gchar* events_path;
+  guint64 limit_events;
+
+  gint64 last_notified;
+};
+
+G_DEFINE_TYPE(MemoryPressureMonitor, memory_pressure_monitor, G_TYPE_OBJECT)
+
+static void notify(MemoryPressureMonitor* self) {
+  gint64 now = g_get_monotonic_time();
+  if (self->last_notified != 0 && now - self->last_notified < kMinIntervalUs) {
+    return;
+  }
+  self->last_notified = now;
+
+  g_autoptr(FlValue) message = fl_value_new_map();
+  fl_value_set_string_take(message, "type",
+                           fl_value_new_string("memoryPressure"));
+  fl_basic_message_channel_send(self->channel, message, nullptr, nullptr,
+                                nullptr);
+}
+
+// Called when the PSI trigger fires.
+static gboolean psi_cb(gint fd, GIOCondition condition, gpointer user_data) {
+  MemoryPressureMonitor* self = MEMORY_PRESSURE_MONITOR(user_data);
+  if (condition & (G_IO_ERR | G_IO_NVAL)) {
+    g_warning("Memory pressure trigger stopped");
+    self->psi_source = 0;
+    return G_SOURCE_REMOVE;
+  }
+  notify(self);
+  return G_SOURCE_CONTINUE;
+}
+
+static void start_psi(MemoryPressureMonitor* self) {
+  self->psi_fd =
+      open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (self->psi_fd < 0) {
+    return;
+  }
+  if (write(self->psi_fd, kPsiTrigger, strlen(kPsiTrigger) + 1) < 0) {
+    close(self->psi_fd);
+    self->psi_fd = -1;
+    return;
+  }
+  self->psi_source = g_unix_fd_add(self->psi_fd, G_IO_PRI, psi_cb, self);
+}
+
+// Returns the path of memory.events for the cgroup v2 of this process.
+static gchar* find_events_path() {
+  g_autofree gchar* contents = nullptr;
+  if (!g_file_get_contents("/proc/self/cgroup", &contents, nullptr, nullptr)) {
+    return nullptr;
+  }
+  g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+  for (gchar** line = lines; *line != nullptr; line++) {
+    if (g_str_has_prefix(*line, "0::")) {
+      return g_build_filename("/sys/fs/cgroup", *line + 3, "memory.events",
+                              nullptr);
+    }
+  }
+  return nullptr;
+}
+
+// Returns how often the cgroup hit its high or max limit.
+static guint64 read_limit_events(const gchar* path) {
+  g_autofree gchar* contents = nullptr;
+  if (!g_file_get_contents(path, &contents, nullptr, nullptr)) {
+    return 0;
+  }
+  guint64 events = 0;
+  g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+  for (gchar** line = lines; *line != nullptr; line++) {
+    if (g_str_has_prefix(*line, "high ")) {
+      events += g_ascii_strtoull(*line + 5, nullptr, 10);
+    } else if (g_str_has_prefix(*line, "max ")) {
+      events += g_ascii_strtoull(*line + 4, nullptr, 10);
+    }
+  }
+  return events;
+}
+
+// Called when memory.events changes.
+static void events_cb(GFileMonitor* monitor,
+                      GFile* file,
+                      GFile* other_file,
+                      GFileMonitorEvent event_type,
+                      gpointer user_data) {
+  MemoryPressureMonitor* self = MEMORY_PRESSURE_MONITOR(user_data);
+  if (event_type != G_FILE_MONITOR_EVENT_CHANGED) {
+    return;
+  }
+  guint64 events = read_limit_events(self->events_path);
+  if (events > self->limit_events) {
+    notify(self);
+  }
+  self->limit_events = events;
+}
+
+static void start_events(MemoryPressureMonitor* self) {
+  self->events_path = find_events_path();
+  if (self->events_path == nullptr ||
+      !g_file_test(self->events_path, G_FILE_TEST_EXISTS)) {
+    return;
+  }
+  g_autoptr(GFile) file = g_file_new_for_path(self->events_path);
+  g_autoptr(GError) error = nullptr;
+  self->events_monitor =
+      g_file_monitor_file(file, G_FILE_MONITOR_NONE, nullptr, &error);
+  if (self->events_monitor == nullptr) {
+    g_warning("Failed to watch %s: %s", self->events_path, error->message);
+    return;
+  }
+  self->limit_events = read_limit_events(self->events_path);
+  g_signal_connect(self->events_monitor, "changed", G_CALLBACK(events_cb),
+                   self);
+}
+
+// Implements GObject::dispose.
+static void memory_pressure_monitor_dispose(GObject* object) {
+  MemoryPressureMonitor* self = MEMORY_PRESSURE_MONITOR(object);
+  g_clear_handle_id(&self->psi_source, g_source_remove);
+  if (self->psi_fd >= 0) {
+    close(self->psi_fd);
+    self->psi_fd = -1;
+  }
+  if (self->events_monitor != nullptr) {
+    g_file_monitor_cancel(self->events_monitor);
+  }
+  g_clear_object(&self->events_monitor);
+  g_clear_pointer(&self->events_path, g_free);
+  g_clear_object(&self->channel);
+  G_OBJECT_CLASS(memory_pressure_monitor_parent_class)->dispose(object);
+}
+
+static void memory_pressure_monitor_class_init(
+    MemoryPressureMonitorClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = memory_pressure_monitor_dispose;
+}
+
+static void memory_pressure_monitor_init(MemoryPressureMonitor* self) {
+  self->psi_fd = -1;
+}
+
+MemoryPressureMonitor* memory_pressure_monitor_new(
+    FlBinaryMessenger* messenger) {
+  MemoryPressureMonitor* self = MEMORY_PRESSURE_MONITOR(
+      g_object_new(memory_pressure_monitor_get_type(), nullptr));
+
+  // The framework handles "memoryPressure" on this channel by calling
+  // WidgetsBindingObserver.didHaveMemoryPressure.
+  g_autoptr(FlJsonMessageCodec) codec = fl_json_message_codec_new();
+  self->channel = fl_basic_message_channel_new(messenger, "flutter/system",
+                                               FL_MESSAGE_CODEC(codec));
+
+  start_psi(self);
+  start_events(self);
+  return self;
+}
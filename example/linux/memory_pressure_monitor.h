@@ -0,0 +1,26 @@
+#ifndef FLUTTER_MEMORY_PRESSURE_MONITOR_H_
+#define FLUTTER_MEMORY_PRESSURE_MONITOR_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(MemoryPressureMonitor,
+                     memory_pressure_monitor,
+                     MEMORY,
+                     PRESSURE_MONITOR,
+                     GObject)
+
+/**
+ * memory_pressure_monitor_new:
+ * @messenger: messenger of the engine to notify.
+ *
+ * Watches a PSI trigger on /proc/pressure/memory and the memory.events file
+ * of the process cgroup, and sends the framework's "memoryPressure" system
+ * message whenever either reports that memory is short. Sources that are not
+ * available, such as PSI on older kernels, are skipped.
+ *
+ * Returns: a new #MemoryPressureMonitor.
+ */
+MemoryPressureMonitor* memory_pressure_monitor_new(
+    FlBinaryMessenger* messenger);
+
+#endif  // FLUTTER_MEMORY_PRESSURE_MONITOR_H_
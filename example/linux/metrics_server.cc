@@ -0,0 +1,190 @@
+#include "metrics_server.h"
+
+#include <gio/gunixsocketaddress.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static constexpr guint16 kDefaultPort = 9464;
+static constexpr int kMaxThreads = 4;
+static constexpr guint kTimeoutSeconds = 5;
+
+// Written on the main thread, read by the connection threads. Reference
+// counted, since a connection may still be served after the server is
+// disposed.
+struct Snapshot {
+  GMutex lock;
+  gchar* text;
+};
+
+struct _MetricsServer {
+  GObject parent_instance;
+  FlBasicMessageChannel* channel;
+  GSocketService* service;
+  Snapshot* snapshot;
+
+  // The Unix socket listened on, if any, removed again on dispose.
+  gchar* socket_path;
+};
+
+G_DEFINE_TYPE(MetricsServer, metrics_server, G_TYPE_OBJECT)
+
+static Snapshot* snapshot_new() {
+  Snapshot* snapshot = g_atomic_rc_box_new0(Snapshot);
+  g_mutex_init(&snapshot->lock);
+  return snapshot;
+}
+
+static void snapshot_clear(gpointer data) {
+  Snapshot* snapshot = static_cast<Snapshot*>(data);
+  g_free(snapshot->text);
+  g_mutex_clear(&snapshot->lock);
+}
+
+static void snapshot_unref(gpointer data) {
+  g_atomic_rc_box_release_full(data, snapshot_clear);
+}
+
+// Drops the reference held by the "run" handler once it is disconnected.
+static void snapshot_closure_notify(gpointer data, GClosure* closure) {
+  snapshot_unref(data);
+}
+
+// Keeps the latest snapshot pushed by Dart.
+static void snapshot_cb(FlBasicMessageChannel* channel,
+                        FlValue* message,
+                        FlBasicMessageChannelResponseHandle* response_handle,
+                        gpointer user_data) {
+  MetricsServer* self = METRICS_SERVER(user_data);
+  if (message != nullptr &&
+      fl_value_get_type(message) == FL_VALUE_TYPE_STRING) {
+    Snapshot* snapshot = self->snapshot;
+    g_mutex_lock(&snapshot->lock);
+    g_free(snapshot->text);
+    snapshot->text = g_strdup(fl_value_get_string(message));
+    g_mutex_unlock(&snapshot->lock);
+  }
+  g_autoptr(FlValue) reply = fl_value_new_string("");
+  fl_basic_message_channel_respond(channel, response_handle, reply, nullptr);
+}
+
+// Implements GThreadedSocketService::run, on a worker thread. Only touches
+// the snapshot, which the handler keeps alive, never the server itself.
+static gboolean run_cb(GThreadedSocketService* service,
+                       GSocketConnection* connection,
+                       GObject* source_object,
+                       gpointer user_data) {
+  Snapshot* snapshot = static_cast<Snapshot*>(user_data);
+  g_socket_set_timeout(g_socket_connection_get_socket(connection),
+                       kTimeoutSeconds);
+
+  // Every path serves the metrics, so the request is read only to drain it.
+  gchar request[4096];
+  GInputStream* input = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+  g_input_stream_read(input, request, sizeof(request), nullptr, nullptr);
+
+  g_mutex_lock(&snapshot->lock);
+  g_autofree gchar* body =
+      g_strdup(snapshot->text != nullptr ? snapshot->text : "");
+  g_mutex_unlock(&snapshot->lock);
+
+  g_autofree gchar* response = g_strdup_printf(
+      "HTTP/1.0 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: %zu\r\n"
+      "\r\n"
+      "%s",
+      strlen(body), body);
+  GOutputStream* output =
+      g_io_stream_get_output_stream(G_IO_STREAM(connection));
+  g_output_stream_write_all(output, response, strlen(response), nullptr,
+                            nullptr, nullptr);
+  return TRUE;
+}
+
+static gboolean start_listening(MetricsServer* self, GError** error) {
+  GSocketListener* listener = G_SOCKET_LISTENER(self->service);
+  const gchar* socket_path = g_getenv("HTMLTOPDF_METRICS_SOCKET");
+  g_autoptr(GSocketAddress) address = nullptr;
+  if (socket_path != nullptr) {
+    // Remove a socket left behind by a previous run, but nothing else.
+    GStatBuf st;
+    if (g_lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+      g_unlink(socket_path);
+    }
+    address = g_unix_socket_address_new(socket_path);
+  } else {
+    const gchar* port = g_getenv("HTMLTOPDF_METRICS_PORT");
+    g_autoptr(GInetAddress) loopback =
+        g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    guint16 port_number =
+        port != nullptr
+            ? static_cast<guint16>(g_ascii_strtoull(port, nullptr, 10))
+            : kDefaultPort;
+    address = g_inet_socket_address_new(loopback, port_number);
+  }
+  if (!g_socket_listener_add_address(listener, address, G_SOCKET_TYPE_STREAM,
+                                     G_SOCKET_PROTOCOL_DEFAULT, nullptr,
+                                     nullptr, error)) {
+    return FALSE;
+  }
+  self->socket_path = g_strdup(socket_path);
+  return TRUE;
+}
+
+// Implements GObject::dispose.
+static void metrics_server_dispose(GObject* object) {
+  MetricsServer* self = METRICS_SERVER(object);
+  if (self->service != nullptr) {
+    g_socket_service_stop(self->service);
+    g_socket_listener_close(G_SOCKET_LISTENER(self->service));
+  }
+  if (self->socket_path != nullptr) {
+    g_unlink(self->socket_path);
+    g_clear_pointer(&self->socket_path, g_free);
+  }
+  g_clear_object(&self->service);
+  g_clear_object(&self->channel);
+  G_OBJECT_CLASS(metrics_server_parent_class)->dispose(object);
+}
+
+// Implements GObject::finalize.
+static void metrics_server_finalize(GObject* object) {
+  MetricsServer* self = METRICS_SERVER(object);
+  g_clear_pointer(&self->snapshot, snapshot_unref);
+  G_OBJECT_CLASS(metrics_server_parent_class)->finalize(object);
+}
+
+static void metrics_server_class_init(MetricsServerClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = metrics_server_dispose;
+  G_OBJECT_CLASS(klass)->finalize = metrics_server_finalize;
+}
+
+static void metrics_server_init(MetricsServer* self) {
+  self->snapshot = snapshot_new();
+}
+
+MetricsServer* metrics_server_new(FlBinaryMessenger* messenger) {
+  g_autoptr(MetricsServer) self =
+      METRICS_SERVER(g_object_new(metrics_server_get_type(), nullptr));
+
+  self->service = g_threaded_socket_service_new(kMaxThreads);
+  g_autoptr(GError) error = nullptr;
+  if (!start_listening(self, &error)) {
+    g_warning("Failed to start metrics server: %s", error->message);
+    return nullptr;
+  }
+  g_signal_connect_data(self->service, "run", G_CALLBACK(run_cb),
+                        g_atomic_rc_box_acquire(self->snapshot),
+                        snapshot_closure_notify,
+                        static_cast<GConnectFlags>(0));
+  g_socket_service_start(self->service);
+
+  g_autoptr(FlStringCodec) codec = fl_string_codec_new();
+  self->channel = fl_basic_message_channel_new(
+      messenger, "htmltopdfwidgets/metrics", FL_MESSAGE_CODEC(codec));
+  fl_basic_message_channel_set_message_handler(self->channel, snapshot_cb,
+                                               self, nullptr);
+
+  return METRICS_SERVER(g_steal_pointer(&self));
+}
@@ -0,0 +1,22 @@
+#ifndef FLUTTER_METRICS_SERVER_H_
+#define FLUTTER_METRICS_SERVER_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(MetricsServer, metrics_server, METRICS, SERVER, GObject)
+
+/**
+ * metrics_server_new:
+ * @messenger: messenger of the engine the Dart side reports through.
+ *
+ * Serves the latest snapshot sent by Dart on the "htmltopdfwidgets/metrics"
+ * channel, in the Prometheus text format. Listens on the Unix socket named
+ * by HTMLTOPDF_METRICS_SOCKET if set, otherwise on the loopback port
+ * HTMLTOPDF_METRICS_PORT (9464 by default). The socket file is removed again
+ * when the server is disposed.
+ *
+ * Returns: a new #MetricsServer, or %NULL if it could not listen.
+ */
+MetricsServer* metrics_server_new(FlBinaryMessenger* messenger);
+
+#endif  // FLUTTER_METRICS_SERVER_H_
@@ -6,17 +6,27 @@
 #endif
 
 #include "flutter/generated_plugin_registrant.h"
+#include "memory_pressure_monitor.h"
+#include "metrics_server.h"
+#include "startup_trace.h"
 
 struct _MyApplication {
   GtkApplication parent_instance;
   char** dart_entrypoint_arguments;
+  MetricsServer* metrics_server;
+  MemoryPressureMonitor* memory_pressure_monitor;
 };
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION)
 
+static void first_frame_cb(FlView* view) {
+  startup_trace_mark("first frame");
+}
+
 // Implements GApplication::activate.
 static void my_application_activate(GApplication* application) {
   MyApplication* self = MY_APPLICATION(application);
+  startup_trace_mark("gtk init");
   GtkWindow* window =
       GTK_WINDOW(gtk_application_window_new(GTK_APPLICATION(application)));
 
@@ -49,15 +59,32 @@ static void my_application_activate(GApplication* application) {
 
   gtk_window_set_default_size(window, 1280, 720);
   gtk_widget_show(GTK_WIDGET(window));
+  startup_trace_mark("window");
 
   g_autoptr(FlDartProject) project = fl_dart_project_new();
   fl_dart_project_set_dart_entrypoint_arguments(project, self->dart_entrypoint_arguments);
 
   FlView* view = fl_view_new(project);
+  // Older engines have no such signal.
+  if (g_signal_lookup("first-frame", fl_view_get_type()) != 0) {
+    g_signal_connect(view, "first-frame", G_CALLBACK(first_frame_cb), nullptr);
+  }
   gtk_widget_show(GTK_WIDGET(view));
   gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(view));
+  // The view is realized here, which starts the engine and loads the AOT
+  // snapshot.
+  startup_trace_mark("engine start");
 
+  // Plugins are registered eagerly: registration is what installs their
+  // channel handlers, and a Dart call made before that would be dropped.
+  // Printing registers a single method channel, so there is little to save.
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
+  startup_trace_mark("plugin registration");
+
+  FlBinaryMessenger* messenger =
+      fl_engine_get_binary_messenger(fl_view_get_engine(view));
+  self->metrics_server = metrics_server_new(messenger);
+  self->memory_pressure_monitor = memory_pressure_monitor_new(messenger);
 
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
@@ -85,6 +112,8 @@ static gboolean my_application_local_command_line(GApplication* application, gch
 static void my_application_dispose(GObject* object) {
   MyApplication* self = MY_APPLICATION(object);
   g_clear_pointer(&self->dart_entrypoint_arguments, g_strfreev);
+  g_clear_object(&self->metrics_server);
+  g_clear_object(&self->memory_pressure_monitor);
   G_OBJECT_CLASS(my_application_parent_class)->dispose(object);
 }
 
@@ -0,0 +1,20 @@
+#include "startup_trace.h"
+
+static gint64 first_mark = 0;
+static gint64 last_mark = 0;
+
+void startup_trace_mark(const gchar* phase) {
+  static const gboolean enabled =
+      g_getenv("HTMLTOPDF_STARTUP_TRACE") != nullptr;
+  if (!enabled) {
+    return;
+  }
+  gint64 now = g_get_monotonic_time();
+  if (first_mark == 0) {
+    first_mark = now;
+    last_mark = now;
+  }
+  g_message("startup: %s %.1f ms (%.1f ms total)", phase,
+            (now - last_mark) / 1000.0, (now - first_mark) / 1000.0);
+  last_mark = now;
+}
@@ -0,0 +1,16 @@
+#ifndef FLUTTER_STARTUP_TRACE_H_
+#define FLUTTER_STARTUP_TRACE_H_
+
+#include <glib.h>
+
+/**
+ * startup_trace_mark:
+ * @phase: name of the phase that just ended.
+ *
+ * Logs how long @phase took and the time since the first mark, when the
+ * HTMLTOPDF_STARTUP_TRACE environment variable is set. Does nothing
+ * otherwise.
+ */
+void startup_trace_mark(const gchar* phase);
+
+#endif  // FLUTTER_STARTUP_TRACE_H_
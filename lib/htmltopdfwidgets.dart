@@ -2,4 +2,15 @@ library htmltopdfwidgets;
 
 export 'package:pdf/pdf.dart';
 export 'package:pdf/widgets.dart';
+export 'src/conversion_metrics.dart';
+export 'src/conversion_scheduler.dart';
+export 'src/converter_config.dart';
+export 'src/html_font_cache.dart';
+export 'src/html_hyphenator.dart';
+export 'src/html_image_cache.dart';
+export 'src/html_image_optimizer.dart';
+export 'src/html_memory_pressure.dart';
+export 'src/html_page_template.dart' show HtmlPageTemplate;
 export 'src/html_to_widgets_codec.dart';
+export 'src/pdf_text_writer.dart' show TextLayoutCache;
+export 'src/pdf_thumbnails.dart';
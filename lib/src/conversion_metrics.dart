@@ -0,0 +1,225 @@
+import 'dart:math' as math;
+
+import 'conversion_scheduler.dart';
+
+/// Latency histogram with logarithmic buckets.
+///
+/// Bucket bounds grow by a factor of [_growth] from [_lowest] seconds, so
+/// any recorded value is known to within about 20% from 100µs to minutes.
+class LatencyHistogram {
+  static const _lowest = 0.0001;
+  static const _growth = 1.189207115; // 2^(1/4)
+  static const _bucketCount = 96;
+
+  static final bounds = List<double>.generate(
+      _bucketCount, (i) => _lowest * math.pow(_growth, i),
+      growable: false);
+
+  final _counts = List<int>.filled(_bucketCount + 1, 0);
+
+  int count = 0;
+  double sum = 0;
+
+  void record(Duration duration) {
+    final seconds = duration.inMicroseconds / Duration.microsecondsPerSecond;
+    var bucket = 0;
+    if (seconds > _lowest) {
+      // Anything past the last bound lands in the overflow bucket.
+      bucket = math.min(
+          (math.log(seconds / _lowest) / math.log(_growth)).ceil(),
+          _bucketCount);
+      // Rounding can land one bucket off either side of an exact bound.
+      while (bucket > 0 && seconds <= bounds[bucket - 1]) {
+        bucket--;
+      }
+      while (bucket < _bucketCount && seconds > bounds[bucket]) {
+        bucket++;
+      }
+    }
+    _counts[bucket]++;
+    count++;
+    sum += seconds;
+  }
+
+  /// Upper bound of the bucket holding the [quantile] of recorded values.
+  double percentile(double quantile) {
+    final rank = (count * quantile).ceil();
+    var seen = 0;
+    for (var i = 0; i < _bucketCount; i++) {
+      seen += _counts[i];
+      if (seen >= rank && seen > 0) {
+        return bounds[i];
+      }
+    }
+    return double.infinity;
+  }
+}
+
+/// Process-wide counters for conversions, exported in the Prometheus text
+/// format by [toPrometheus].
+class ConversionMetrics {
+  ConversionMetrics._();
+
+  static final instance = ConversionMetrics._();
+
+  final _stages = <String, LatencyHistogram>{};
+  final _cacheHits = <String, int>{};
+  final _cacheMisses = <String, int>{};
+  final _errors = <String, int>{};
+  final _shrinks = <int, int>{};
+
+  int bytesIn = 0;
+  int bytesOut = 0;
+
+  /// Queue depth and utilization are read from it on export.
+  ConversionScheduler? scheduler;
+
+  void record(String stage, Duration duration) {
+    _stages.putIfAbsent(stage, () => LatencyHistogram()).record(duration);
+  }
+
+  /// Runs [action], recording its duration under [stage] and any error by
+  /// type.
+  Future<T> time<T>(String stage, Future<T> Function() action) async {
+    final stopwatch = Stopwatch()..start();
+    try {
+      return await action();
+    } catch (e) {
+      error(e);
+      rethrow;
+    } finally {
+      record(stage, stopwatch.elapsed);
+    }
+  }
+
+  void cache(String name, {required bool hit}) {
+    final counts = hit ? _cacheHits : _cacheMisses;
+    counts[name] = (counts[name] ?? 0) + 1;
+  }
+
+  /// Counts a memory pressure shrink reaching [level].
+  void shrink(int level) {
+    _shrinks[level] = (_shrinks[level] ?? 0) + 1;
+  }
+
+  void error(Object error) {
+    final type = error.runtimeType.toString();
+    _errors[type] = (_errors[type] ?? 0) + 1;
+  }
+
+  LatencyHistogram? stage(String stage) => _stages[stage];
+
+  double cacheHitRate(String name) {
+    final hits = _cacheHits[name] ?? 0;
+    final total = hits + (_cacheMisses[name] ?? 0);
+    return total == 0 ? 0 : hits / total;
+  }
+
+  void reset() {
+    _stages.clear();
+    _cacheHits.clear();
+    _cacheMisses.clear();
+    _errors.clear();
+    _shrinks.clear();
+    bytesIn = 0;
+    bytesOut = 0;
+  }
+
+  String toPrometheus() {
+    final out = StringBuffer();
+
+    out.writeln('# TYPE htmltopdf_stage_seconds histogram');
+    for (final entry in _stages.entries) {
+      final histogram = entry.value;
+      final stage = _label(entry.key);
+      var cumulative = 0;
+      for (var i = 0; i < LatencyHistogram._bucketCount; i++) {
+        final count = histogram._counts[i];
+        cumulative += count;
+        // Empty buckets add nothing to a cumulative histogram.
+        if (count > 0) {
+          out.writeln('htmltopdf_stage_seconds_bucket{stage="$stage",'
+              'le="${LatencyHistogram.bounds[i]}"} $cumulative');
+        }
+      }
+      out
+        ..writeln('htmltopdf_stage_seconds_bucket{stage="$stage",le="+Inf"} '
+            '${histogram.count}')
+        ..writeln('htmltopdf_stage_seconds_sum{stage="$stage"} '
+            '${histogram.sum}')
+        ..writeln('htmltopdf_stage_seconds_count{stage="$stage"} '
+            '${histogram.count}');
+    }
+
+    out.writeln('# TYPE htmltopdf_cache_requests_total counter');
+    for (final name in {..._cacheHits.keys, ..._cacheMisses.keys}) {
+      out
+        ..writeln('htmltopdf_cache_requests_total{cache="${_label(name)}",'
+            'result="hit"} ${_cacheHits[name] ?? 0}')
+        ..writeln('htmltopdf_cache_requests_total{cache="${_label(name)}",'
+            'result="miss"} ${_cacheMisses[name] ?? 0}');
+    }
+    out.writeln('# TYPE htmltopdf_cache_hit_ratio gauge');
+    for (final name in {..._cacheHits.keys, ..._cacheMisses.keys}) {
+      out.writeln('htmltopdf_cache_hit_ratio{cache="${_label(name)}"} '
+          '${cacheHitRate(name)}');
+    }
+
+    out
+      ..writeln('# TYPE htmltopdf_input_bytes_total counter')
+      ..writeln('htmltopdf_input_bytes_total $bytesIn')
+      ..writeln('# TYPE htmltopdf_output_bytes_total counter')
+      ..writeln('htmltopdf_output_bytes_total $bytesOut')
+      ..writeln('# TYPE htmltopdf_errors_total counter');
+    for (final entry in _errors.entries) {
+      out.writeln('htmltopdf_errors_total{type="${_label(entry.key)}"} '
+          '${entry.value}');
+    }
+
+    out.writeln('# TYPE htmltopdf_memory_shrinks_total counter');
+    for (final entry in _shrinks.entries) {
+      out.writeln('htmltopdf_memory_shrinks_total{level="${entry.key}"} '
+          '${entry.value}');
+    }
+
+    final scheduler = this.scheduler;
+    if (scheduler != null) {
+      out.writeln('# TYPE htmltopdf_queue_depth gauge');
+      for (final lane in ConversionLane.values) {
+        out.writeln('htmltopdf_queue_depth{lane="${lane.name}"} '
+            '${scheduler.queued(lane)}');
+      }
+      out.writeln('# TYPE htmltopdf_queue_wait_seconds gauge');
+      for (final lane in ConversionLane.values) {
+        final wait = scheduler.averageWait(lane).inMicroseconds /
+            Duration.microsecondsPerSecond;
+        out.writeln('htmltopdf_queue_wait_seconds{lane="${lane.name}"} $wait');
+      }
+      out
+        ..writeln('# TYPE htmltopdf_worker_utilization gauge')
+        ..writeln('htmltopdf_worker_utilization '
+            '${scheduler.running / scheduler.concurrency}')
+        ..writeln('# TYPE htmltopdf_jobs_total counter')
+        ..writeln('htmltopdf_jobs_total{result="completed"} '
+            '${scheduler.completed}')
+        ..writeln('htmltopdf_jobs_total{result="failed"} ${scheduler.failed}')
+        ..writeln('htmltopdf_jobs_total{result="cancelled"} '
+            '${scheduler.cancelled}')
+        ..writeln('htmltopdf_jobs_total{result="rejected"} '
+            '${scheduler.rejected}')
+        ..writeln('# TYPE htmltopdf_preemptions_total counter')
+        ..writeln('htmltopdf_preemptions_total ${scheduler.preempted}')
+        ..writeln('# TYPE htmltopdf_large_jobs_paused gauge')
+        ..writeln('htmltopdf_large_jobs_paused '
+            '${scheduler.largeJobsPaused ? 1 : 0}');
+    }
+    return out.toString();
+  }
+
+  static String _label(String value) {
+    return value
+        .replaceAll(r'\', r'\\')
+        .replaceAll('"', r'\"')
+        .replaceAll('\n', r'\n');
+  }
+}
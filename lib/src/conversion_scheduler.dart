@@ -0,0 +1,325 @@
+import 'dart:async';
+import 'dart:collection';
+
+import '../htmltopdfwidgets.dart';
+
+enum ConversionLane { interactive, batch }
+
+class ConversionRejectedException implements Exception {
+  ConversionRejectedException(this.message);
+
+  final String message;
+
+  @override
+  String toString() => 'ConversionRejectedException: $message';
+}
+
+class ConversionCancelledException implements Exception {
+  @override
+  String toString() => 'ConversionCancelledException';
+}
+
+/// Lets the caller of [ConversionScheduler.schedule] cancel the job it
+/// started, for instance a preview that is no longer shown.
+class ConversionCancelToken {
+  final _jobs = <ConversionJob>[];
+  bool _cancelled = false;
+
+  bool get isCancelled => _cancelled;
+
+  /// Cancels every job scheduled with this token, and any scheduled later.
+  void cancel() {
+    _cancelled = true;
+    for (final job in List.of(_jobs)) {
+      job.cancel();
+    }
+  }
+}
+
+/// Handle given to a scheduled task.
+class ConversionJob {
+  ConversionJob._(this._scheduler, this.lane, this.cost);
+
+  final ConversionScheduler _scheduler;
+  final ConversionLane lane;
+  final int cost;
+
+  final _waiting = Stopwatch();
+  Completer<void>? _grant;
+  bool _cancelled = false;
+
+  /// Whether the job currently holds one of the scheduler's slots.
+  bool _running = false;
+
+  /// Whether the job has been given a slot before, so that it is counted
+  /// once in [ConversionScheduler.averageWait] however often it is
+  /// preempted.
+  bool _started = false;
+
+  bool get isCancelled => _cancelled;
+
+  /// Stops the job at its next [checkpoint], or right away while it waits
+  /// for a slot.
+  void cancel() {
+    if (_cancelled) {
+      return;
+    }
+    _cancelled = true;
+    _scheduler._cancelQueued(this);
+  }
+
+  /// Called by the task between blocks or pages.
+  ///
+  /// Throws [ConversionCancelledException] once the job is cancelled. A
+  /// batch job hands its slot over here while interactive work is waiting,
+  /// and resumes when the scheduler gives it a slot again.
+  Future<void> checkpoint() async {
+    if (_cancelled) {
+      throw ConversionCancelledException();
+    }
+    if (lane == ConversionLane.batch && _scheduler._shouldPreempt) {
+      await _scheduler._preempt(this);
+      if (_cancelled) {
+        throw ConversionCancelledException();
+      }
+    }
+  }
+}
+
+/// Runs conversions with a bounded number in flight, favouring interactive
+/// previews over batch exports.
+///
+/// When both lanes are waiting, up to [interactiveWeight] interactive jobs
+/// start for every batch job. Running batch jobs give their slot up at
+/// their next [ConversionJob.checkpoint] while interactive jobs are queued.
+/// A job is rejected up front when its lane already holds [maxQueued] jobs
+/// or [maxQueuedCost] of estimated cost, and jobs of at least
+/// [largeJobCost] are rejected while [pauseLargeJobs] is in effect.
+class ConversionScheduler {
+  ConversionScheduler({
+    this.concurrency = 2,
+    this.interactiveWeight = 4,
+    this.maxQueued = 256,
+    this.maxQueuedCost = 64 * 1024 * 1024,
+    this.largeJobCost = 1024 * 1024,
+  });
+
+  final int concurrency;
+  final int interactiveWeight;
+  final int maxQueued;
+  final int maxQueuedCost;
+  final int largeJobCost;
+
+  final _queues = {
+    ConversionLane.interactive: Queue<ConversionJob>(),
+    ConversionLane.batch: Queue<ConversionJob>(),
+  };
+  final _queuedCost = {
+    ConversionLane.interactive: 0,
+    ConversionLane.batch: 0,
+  };
+  final _waited = {
+    ConversionLane.interactive: Duration.zero,
+    ConversionLane.batch: Duration.zero,
+  };
+  final _started = {
+    ConversionLane.interactive: 0,
+    ConversionLane.batch: 0,
+  };
+
+  int _running = 0;
+  int _interactiveStreak = 0;
+  DateTime? _largeJobsPausedUntil;
+
+  int completed = 0;
+  int failed = 0;
+  int cancelled = 0;
+  int rejected = 0;
+  int preempted = 0;
+
+  int get running => _running;
+
+  int queued(ConversionLane lane) => _queues[lane]!.length;
+
+  int queuedCost(ConversionLane lane) => _queuedCost[lane]!;
+
+  bool get largeJobsPaused {
+    final until = _largeJobsPausedUntil;
+    return until != null && DateTime.now().isBefore(until);
+  }
+
+  /// Refuses new jobs of at least [largeJobCost] for [duration], typically
+  /// while memory is short. Jobs already admitted carry on.
+  void pauseLargeJobs(Duration duration) {
+    _largeJobsPausedUntil = DateTime.now().add(duration);
+  }
+
+  /// Average time jobs of [lane] spent waiting for a slot.
+  Duration averageWait(ConversionLane lane) {
+    final started = _started[lane]!;
+    return started == 0 ? Duration.zero : _waited[lane]! ~/ started;
+  }
+
+  /// Runs [task] once a slot is free in [lane]. [cost] estimates the work,
+  /// typically the input size.
+  ///
+  /// Cancelling [cancelToken] completes the returned future with
+  /// [ConversionCancelledException]: at once while the job is queued, or at
+  /// its next [ConversionJob.checkpoint] once it runs.
+  Future<T> schedule<T>(Future<T> Function(ConversionJob job) task,
+      {ConversionLane lane = ConversionLane.batch,
+      int cost = 0,
+      ConversionCancelToken? cancelToken}) async {
+    final job = ConversionJob._(this, lane, cost);
+    if (cancelToken != null) {
+      if (cancelToken.isCancelled) {
+        cancelled++;
+        throw ConversionCancelledException();
+      }
+      cancelToken._jobs.add(job);
+    }
+    try {
+      await _acquire(job);
+      try {
+        if (job.isCancelled) {
+          throw ConversionCancelledException();
+        }
+        final result = await task(job);
+        completed++;
+        return result;
+      } finally {
+        _release(job);
+      }
+    } on ConversionCancelledException {
+      cancelled++;
+      rethrow;
+    } on ConversionRejectedException {
+      rethrow;
+    } catch (_) {
+      failed++;
+      rethrow;
+    } finally {
+      cancelToken?._jobs.remove(job);
+    }
+  }
+
+  /// Converts [html] under the scheduler, with a checkpoint between blocks.
+  Future<List<Widget>> convert(HTMLToPdf converter, String html,
+      {ConversionLane lane = ConversionLane.batch,
+      ConversionCancelToken? cancelToken}) {
+    return schedule((job) async {
+      final widgets = <Widget>[];
+      await for (final block in converter.convertBlocks(html)) {
+        await job.checkpoint();
+        widgets.add(block);
+      }
+      return widgets;
+    }, lane: lane, cost: html.length, cancelToken: cancelToken);
+  }
+
+  bool get _shouldPreempt =>
+      _running >= concurrency &&
+      _queues[ConversionLane.interactive]!.isNotEmpty;
+
+  Future<void> _acquire(ConversionJob job) {
+    if (job.cost >= largeJobCost && largeJobsPaused) {
+      rejected++;
+      throw ConversionRejectedException(
+          'large jobs are paused (cost ${job.cost})');
+    }
+    final queue = _queues[job.lane]!;
+    if (_running < concurrency && _queues.values.every((q) => q.isEmpty)) {
+      _start(job);
+      return Future.value();
+    }
+    if (queue.length >= maxQueued ||
+        _queuedCost[job.lane]! + job.cost > maxQueuedCost) {
+      rejected++;
+      throw ConversionRejectedException(
+          '${job.lane.name} queue is full (${queue.length} jobs, '
+          '${_queuedCost[job.lane]} queued cost)');
+    }
+    _enqueue(job);
+    return job._grant!.future;
+  }
+
+  Future<void> _preempt(ConversionJob job) {
+    preempted++;
+    _running--;
+    job._running = false;
+    _enqueue(job, first: true);
+    _dispatch();
+    return job._grant!.future;
+  }
+
+  void _enqueue(ConversionJob job, {bool first = false}) {
+    job._grant = Completer<void>();
+    job._waiting
+      ..reset()
+      ..start();
+    _queuedCost[job.lane] = _queuedCost[job.lane]! + job.cost;
+    if (first) {
+      _queues[job.lane]!.addFirst(job);
+    } else {
+      _queues[job.lane]!.add(job);
+    }
+  }
+
+  /// Takes [job] out of its queue, if it is waiting there, and fails its
+  /// grant.
+  void _cancelQueued(ConversionJob job) {
+    if (job._running || !_queues[job.lane]!.remove(job)) {
+      return;
+    }
+    _queuedCost[job.lane] = _queuedCost[job.lane]! - job.cost;
+    job._waiting.stop();
+    job._grant!.completeError(ConversionCancelledException());
+  }
+
+  void _release(ConversionJob job) {
+    if (!job._running) {
+      return;
+    }
+    job._running = false;
+    _running--;
+    _dispatch();
+  }
+
+  void _start(ConversionJob job) {
+    _running++;
+    job._running = true;
+    _waited[job.lane] = _waited[job.lane]! + job._waiting.elapsed;
+    if (!job._started) {
+      job._started = true;
+      _started[job.lane] = _started[job.lane]! + 1;
+    }
+  }
+
+  void _dispatch() {
+    while (_running < concurrency) {
+      final job = _next();
+      if (job == null) {
+        return;
+      }
+      _queuedCost[job.lane] = _queuedCost[job.lane]! - job.cost;
+      job._waiting.stop();
+      _start(job);
+      job._grant!.complete();
+    }
+  }
+
+  ConversionJob? _next() {
+    final interactive = _queues[ConversionLane.interactive]!;
+    final batch = _queues[ConversionLane.batch]!;
+    if (interactive.isNotEmpty &&
+        (batch.isEmpty || _interactiveStreak < interactiveWeight)) {
+      _interactiveStreak++;
+      return interactive.removeFirst();
+    }
+    if (batch.isNotEmpty) {
+      _interactiveStreak = 0;
+      return batch.removeFirst();
+    }
+    return null;
+  }
+}
@@ -0,0 +1,79 @@
+import 'package:flutter/foundation.dart' show immutable;
+
+import '../htmltopdfwidgets.dart';
+import 'html_hyphenator.dart';
+import 'html_image_cache.dart';
+import 'html_image_optimizer.dart';
+
+typedef HtmlImageResolver = Future<ImageProvider> Function(String src);
+
+/// Fonts, caches and resolvers shared by any number of conversions.
+///
+/// A config is never modified by a conversion: everything that belongs to a
+/// single job lives in the decoder created for it, so one config can serve
+/// many overlapping [HTMLToPdf] calls without copies or locks.
+@immutable
+class ConverterConfig {
+  ConverterConfig({
+    this.defaultFont,
+    List<Font> fontFallback = const [],
+    this.imageCache,
+    this.imageResolver,
+    this.imageOptimizer,
+    this.grayscale = false,
+    this.hyphenator,
+  }) : fontFallback = List.unmodifiable(fontFallback);
+
+  const ConverterConfig._empty()
+      : defaultFont = null,
+        fontFallback = const [],
+        imageCache = null,
+        imageResolver = null,
+        imageOptimizer = null,
+        grayscale = false,
+        hyphenator = null;
+
+  static const empty = ConverterConfig._empty();
+
+  final Font? defaultFont;
+  final List<Font> fontFallback;
+  final HtmlImageCache? imageCache;
+
+  /// Fetches `<img>` sources, [networkImage] by default.
+  final HtmlImageResolver? imageResolver;
+
+  /// Applied to every fetched image; null, the default, embeds images as
+  /// fetched.
+  ///
+  /// Optimized images other than JPEG are kept decoded, at 4 bytes per
+  /// pixel, so an [imageCache] shared across conversions grows by that
+  /// much per image rather than by its compressed size.
+  final HtmlImageOptimizer? imageOptimizer;
+
+  /// Renders text and images in shades of gray, for monochrome printers.
+  /// Images are then optimized even without an [imageOptimizer].
+  final bool grayscale;
+
+  /// Hyphenates words that overflow a line in [HTMLToPdf.convertText].
+  final HtmlHyphenator? hyphenator;
+
+  ConverterConfig copyWith({
+    Font? defaultFont,
+    List<Font>? fontFallback,
+    HtmlImageCache? imageCache,
+    HtmlImageResolver? imageResolver,
+    HtmlImageOptimizer? imageOptimizer,
+    bool? grayscale,
+    HtmlHyphenator? hyphenator,
+  }) {
+    return ConverterConfig(
+      defaultFont: defaultFont ?? this.defaultFont,
+      fontFallback: fontFallback ?? this.fontFallback,
+      imageCache: imageCache ?? this.imageCache,
+      imageResolver: imageResolver ?? this.imageResolver,
+      imageOptimizer: imageOptimizer ?? this.imageOptimizer,
+      grayscale: grayscale ?? this.grayscale,
+      hyphenator: hyphenator ?? this.hyphenator,
+    );
+  }
+}
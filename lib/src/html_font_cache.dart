@@ -0,0 +1,91 @@
+import 'dart:typed_data';
+
+import '../htmltopdfwidgets.dart';
+import 'conversion_metrics.dart';
+
+/// Process-wide cache of TrueType fonts keyed by their bytes.
+///
+/// Fonts built from identical bytes resolve to the same [Font], so a large
+/// font program is held in memory once however many times callers load it,
+/// and documents sharing the instance reuse its parsed tables. Every
+/// [acquire] must be balanced by a [release]; the font is dropped once its
+/// last user releases it.
+class HtmlFontCache {
+  HtmlFontCache._();
+
+  static final instance = HtmlFontCache._();
+
+  final _fonts = <int, List<_FontEntry>>{};
+
+  Font acquire(ByteData data) {
+    final bytes =
+        data.buffer.asUint8List(data.offsetInBytes, data.lengthInBytes);
+    final entries = _fonts.putIfAbsent(_hash(bytes), () => []);
+    for (final entry in entries) {
+      if (_equals(entry.bytes, bytes)) {
+        entry.references++;
+        ConversionMetrics.instance.cache('font', hit: true);
+        return entry.font;
+      }
+    }
+    ConversionMetrics.instance.cache('font', hit: false);
+    final entry = _FontEntry(bytes, Font.ttf(data));
+    entries.add(entry);
+    return entry.font;
+  }
+
+  void release(Font font) {
+    for (final hash in _fonts.keys) {
+      final entries = _fonts[hash]!;
+      for (final entry in entries) {
+        if (identical(entry.font, font)) {
+          if (--entry.references == 0) {
+            entries.remove(entry);
+            if (entries.isEmpty) {
+              _fonts.remove(hash);
+            }
+          }
+          return;
+        }
+      }
+    }
+  }
+
+  int get length => _fonts.values.fold(0, (sum, e) => sum + e.length);
+
+  void clear() {
+    _fonts.clear();
+  }
+
+  static int _hash(Uint8List bytes) {
+    // FNV-1a
+    var hash = 0x811c9dc5;
+    for (final byte in bytes) {
+      hash = ((hash ^ byte) * 0x01000193) & 0xffffffff;
+    }
+    return hash ^ bytes.length;
+  }
+
+  static bool _equals(Uint8List a, Uint8List b) {
+    if (identical(a, b)) {
+      return true;
+    }
+    if (a.length != b.length) {
+      return false;
+    }
+    for (var i = 0; i < a.length; i++) {
+      if (a[i] != b[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+class _FontEntry {
+  _FontEntry(this.bytes, this.font);
+
+  final Uint8List bytes;
+  final Font font;
+  int references = 1;
+}
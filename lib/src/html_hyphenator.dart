@@ -0,0 +1,149 @@
+import 'dart:collection';
+import 'dart:math' as math;
+
+/// Finds hyphenation points with Liang's algorithm, as used by TeX.
+///
+/// Patterns are given in the TeX format, for instance the `hyph-*.pat.txt`
+/// files of the hyph-utf8 project, and are parsed once per language by
+/// [load]. Results are cached per word.
+///
+/// Punctuation around a word, such as a trailing comma, is ignored: it is
+/// neither matched against the patterns nor counted by [leftMin] and
+/// [rightMin].
+class HtmlHyphenator {
+  HtmlHyphenator.fromPatterns(String patterns,
+      {String exceptions = '', this.leftMin = 2, this.rightMin = 3})
+      : assert(leftMin >= 1),
+        assert(rightMin >= 1) {
+    for (final pattern in patterns.split(_whitespace)) {
+      if (pattern.isNotEmpty) {
+        _addPattern(pattern);
+      }
+    }
+    for (final exception in exceptions.split(_whitespace)) {
+      if (exception.isNotEmpty) {
+        _addException(exception);
+      }
+    }
+  }
+
+  static final _whitespace = RegExp(r'\s+');
+  static final _letter = RegExp(r'[\p{L}\p{M}]', unicode: true);
+  static final _languages = <String, HtmlHyphenator>{};
+
+  /// The hyphenator of [language], parsing [patterns] on first use only.
+  static HtmlHyphenator load(String language, String patterns,
+      {String exceptions = ''}) {
+    return _languages.putIfAbsent(
+        language,
+        () =>
+            HtmlHyphenator.fromPatterns(patterns, exceptions: exceptions));
+  }
+
+  /// Minimum number of letters kept before and after a break, at least one
+  /// each, so that every break lies strictly inside the word.
+  final int leftMin;
+  final int rightMin;
+
+  int maxCachedWords = 10000;
+
+  final _root = _TrieNode();
+  final _exceptions = <String, List<int>>{};
+  final _words = LinkedHashMap<String, List<int>>();
+
+  /// Offsets in [word] where it may be broken with a hyphen, in increasing
+  /// order.
+  List<int> hyphenate(String word) {
+    final cached = _words.remove(word);
+    if (cached != null) {
+      _words[word] = cached;
+      return cached;
+    }
+    final result = List<int>.unmodifiable(_hyphenate(word));
+    _words[word] = result;
+    if (_words.length > maxCachedWords) {
+      _words.remove(_words.keys.first);
+    }
+    return result;
+  }
+
+  List<int> _hyphenate(String word) {
+    var start = 0;
+    var end = word.length;
+    while (start < end && !_letter.hasMatch(word[start])) {
+      start++;
+    }
+    while (end > start && !_letter.hasMatch(word[end - 1])) {
+      end--;
+    }
+    final length = end - start;
+    if (length < leftMin + rightMin) {
+      return const [];
+    }
+    final lower = word.substring(start, end).toLowerCase();
+    final exception = _exceptions[lower];
+    if (exception != null) {
+      return [
+        for (final i in exception)
+          if (i >= leftMin && i <= length - rightMin) start + i
+      ];
+    }
+
+    final text = '.$lower.';
+    final points = List<int>.filled(text.length + 1, 0);
+    for (var i = 0; i < text.length; i++) {
+      var node = _root;
+      for (var j = i; j < text.length; j++) {
+        final next = node.children[text.codeUnitAt(j)];
+        if (next == null) {
+          break;
+        }
+        node = next;
+        final values = node.points;
+        if (values != null) {
+          for (var k = 0; k < values.length; k++) {
+            points[i + k] = math.max(points[i + k], values[k]);
+          }
+        }
+      }
+    }
+
+    // The break before lower[i] is before text[i + 1].
+    return [
+      for (var i = leftMin; i <= length - rightMin; i++)
+        if (points[i + 1].isOdd) start + i
+    ];
+  }
+
+  void _addPattern(String pattern) {
+    final values = <int>[0];
+    var node = _root;
+    for (final c in pattern.codeUnits) {
+      if (c >= 0x30 && c <= 0x39) {
+        values[values.length - 1] = c - 0x30;
+      } else {
+        node = node.children.putIfAbsent(c, () => _TrieNode());
+        values.add(0);
+      }
+    }
+    node.points = values;
+  }
+
+  void _addException(String exception) {
+    final positions = <int>[];
+    final word = StringBuffer();
+    for (final c in exception.codeUnits) {
+      if (c == 0x2d) {
+        positions.add(word.length);
+      } else {
+        word.writeCharCode(c);
+      }
+    }
+    _exceptions[word.toString().toLowerCase()] = positions;
+  }
+}
+
+class _TrieNode {
+  final children = <int, _TrieNode>{};
+  List<int>? points;
+}
@@ -0,0 +1,49 @@
+import 'package:printing/printing.dart';
+
+import '../htmltopdfwidgets.dart';
+import 'conversion_metrics.dart';
+
+/// Shares fetched images between conversions.
+///
+/// A [MemoryImage] is embedded only once per document however often it is
+/// drawn, so handing out the same provider for every `<img>` with the same
+/// source keeps a repeated logo down to a single image object.
+class HtmlImageCache {
+  HtmlImageCache() {
+    _live.removeWhere((cache) => cache.target == null);
+    _live.add(WeakReference(this));
+  }
+
+  static final _live = <WeakReference<HtmlImageCache>>[];
+
+  /// Every cache still in use, for [HtmlMemoryPressure].
+  static Iterable<HtmlImageCache> get live =>
+      _live.map((cache) => cache.target).whereType<HtmlImageCache>();
+
+  final _images = <String, Future<ImageProvider>>{};
+
+  /// The image of [src], fetched once per [variant]: images prepared in
+  /// different ways, such as in color and in gray, are cached apart.
+  Future<ImageProvider> resolve(String src,
+      [Future<ImageProvider> Function(String src) fetch = networkImage,
+      String variant = '']) {
+    final key = variant.isEmpty ? src : '$variant\u0000$src';
+    final cached = _images[key];
+    ConversionMetrics.instance.cache('image', hit: cached != null);
+    if (cached != null) {
+      return cached;
+    }
+    final image = fetch(src);
+    _images[key] = image;
+    image.then((_) {}, onError: (Object e) {
+      _images.remove(key);
+    });
+    return image;
+  }
+
+  int get length => _images.length;
+
+  void clear() {
+    _images.clear();
+  }
+}
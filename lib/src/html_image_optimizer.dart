@@ -0,0 +1,332 @@
+import 'dart:math' as math;
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart' show compute, immutable;
+import 'package:image/image.dart' as img;
+
+import '../htmltopdfwidgets.dart';
+
+/// Prepares fetched images for embedding.
+///
+/// JPEG data is embedded as is, however large, since it is never decoded.
+/// Other formats are decoded on a background isolate when they are fetched
+/// rather than on the main one while the page is painted, and images whose
+/// alpha channel is fully opaque are embedded without a soft mask.
+///
+/// Images above [maxPixels] are downsampled on that isolate, so only the
+/// reduced pixels reach the document and the caches. Images above
+/// [maxDecodedPixels], read from their header, are not decoded at all and
+/// are left out of the document. Decoding thus never holds more than
+/// [maxDecodedPixels] pixels, plus the downsampled copy. Formats whose
+/// header gives no size, such as TGA or ICO, are never decoded here and
+/// are embedded as fetched.
+///
+/// With a [bilevelThreshold], opaque images that are almost entirely black
+/// and white, such as scanned text, are snapped to pure black and white,
+/// which lets their stream compress to a fraction of its size. This is
+/// lossy, so it is off unless asked for.
+///
+/// With `grayscale`, pixels are reduced to their luminance and JPEG data is
+/// re-encoded as a grayscale JPEG, unless the image is above
+/// [maxDecodedPixels] or its size is unknown.
+@immutable
+class HtmlImageOptimizer {
+  const HtmlImageOptimizer({
+    this.maxPixels = 16 * 1024 * 1024,
+    this.maxDecodedPixels = 64 * 1024 * 1024,
+    this.bilevelThreshold,
+    this.bilevelRatio = 0.99,
+  });
+
+  final int maxPixels;
+  final int maxDecodedPixels;
+
+  /// Luminance from 0 to 255 below which a bilevel pixel becomes black,
+  /// typically 128; null, the default, leaves every image as is.
+  final int? bilevelThreshold;
+
+  /// Share of pixels that must already be close to black or white for an
+  /// image to count as bilevel.
+  final double bilevelRatio;
+
+  /// Equal for optimizers whose output is the same for the same input.
+  String get cacheKey =>
+      '$maxPixels,$maxDecodedPixels,$bilevelThreshold,$bilevelRatio';
+
+  Future<ImageProvider> optimize(ImageProvider image,
+      {bool grayscale = false}) async {
+    if (image is! MemoryImage) {
+      return image;
+    }
+    final size = imageSize(image.bytes);
+    if (size == null) {
+      return image;
+    }
+    // Compared by division: the product of two 32-bit dimensions from a
+    // crafted header can overflow.
+    final tooLarge = size[1] != 0 && size[0] > maxDecodedPixels ~/ size[1];
+    if (isJpeg(image.bytes)) {
+      if (!grayscale || tooLarge) {
+        return image;
+      }
+      final jpeg = await compute(_grayJpeg, image.bytes);
+      return jpeg == null ? image : MemoryImage(jpeg);
+    }
+    if (tooLarge) {
+      throw ImageTooLargeException(size[0], size[1]);
+    }
+    final pixels = await compute(
+        _decode, _DecodeJob(image.bytes, this, grayscale: grayscale));
+    return pixels == null ? image : _PixelsImage(pixels);
+  }
+
+  static bool isJpeg(Uint8List bytes) {
+    return bytes.length > 2 && bytes[0] == 0xff && bytes[1] == 0xd8;
+  }
+
+  /// Width and height read from a PNG, GIF, JPEG, BMP, TIFF or WebP
+  /// header, without decoding.
+  static List<int>? imageSize(Uint8List bytes) {
+    final data = ByteData.sublistView(bytes);
+    if (isJpeg(bytes)) {
+      return _jpegSize(data);
+    }
+    try {
+      return _headerSize(data);
+    } on RangeError {
+      // Truncated header.
+      return null;
+    }
+  }
+
+  static List<int>? _headerSize(ByteData data) {
+    final bytes = data.lengthInBytes;
+    // PNG signature, then the IHDR chunk.
+    if (bytes >= 24 &&
+        data.getUint32(0) == 0x89504e47 &&
+        data.getUint32(12) == 0x49484452) {
+      return [data.getUint32(16), data.getUint32(20)];
+    }
+    // GIF87a or GIF89a logical screen.
+    if (bytes >= 10 && data.getUint32(0) == 0x47494638) {
+      return [
+        data.getUint16(6, Endian.little),
+        data.getUint16(8, Endian.little)
+      ];
+    }
+    // BMP file header, then the DIB header.
+    if (bytes >= 26 && data.getUint16(0) == 0x424d) {
+      if (data.getUint32(14, Endian.little) == 12) {
+        return [
+          data.getUint16(18, Endian.little),
+          data.getUint16(20, Endian.little)
+        ];
+      }
+      // Top-down bitmaps have a negative height.
+      return [
+        data.getInt32(18, Endian.little).abs(),
+        data.getInt32(22, Endian.little).abs()
+      ];
+    }
+    // TIFF, little or big endian: the first image file directory.
+    if (bytes >= 8 &&
+        (data.getUint32(0) == 0x49492a00 || data.getUint32(0) == 0x4d4d002a)) {
+      return _tiffSize(data);
+    }
+    // WebP: RIFF container, then a lossy, lossless or extended chunk.
+    if (bytes >= 30 &&
+        data.getUint32(0) == 0x52494646 &&
+        data.getUint32(8) == 0x57454250) {
+      switch (data.getUint32(12)) {
+        case 0x56503820: // 'VP8 '
+          return [
+            data.getUint16(26, Endian.little) & 0x3fff,
+            data.getUint16(28, Endian.little) & 0x3fff
+          ];
+        case 0x5650384c: // 'VP8L'
+          final bits = data.getUint32(21, Endian.little);
+          return [(bits & 0x3fff) + 1, ((bits >> 14) & 0x3fff) + 1];
+        case 0x56503858: // 'VP8X'
+          return [
+            (data.getUint32(24, Endian.little) & 0xffffff) + 1,
+            (data.getUint32(27, Endian.little) & 0xffffff) + 1
+          ];
+      }
+    }
+    return null;
+  }
+
+  static List<int>? _tiffSize(ByteData data) {
+    final endian = data.getUint8(0) == 0x49 ? Endian.little : Endian.big;
+    final directory = data.getUint32(4, endian);
+    final entries = data.getUint16(directory, endian);
+    int? width;
+    int? height;
+    for (var i = 0; i < entries; i++) {
+      final entry = directory + 2 + i * 12;
+      final tag = data.getUint16(entry, endian);
+      if (tag != 256 && tag != 257) {
+        continue;
+      }
+      // SHORT or LONG, stored in the entry itself.
+      final value = data.getUint16(entry + 2, endian) == 3
+          ? data.getUint16(entry + 8, endian)
+          : data.getUint32(entry + 8, endian);
+      if (tag == 256) {
+        width = value;
+      } else {
+        height = value;
+      }
+    }
+    return width == null || height == null ? null : [width, height];
+  }
+
+  static List<int>? _jpegSize(ByteData data) {
+    var offset = 2;
+    while (offset + 9 < data.lengthInBytes) {
+      if (data.getUint8(offset) != 0xff) {
+        return null;
+      }
+      final marker = data.getUint8(offset + 1);
+      if (marker == 0xff) {
+        offset++;
+      } else if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)) {
+        offset += 2;
+      } else if (marker >= 0xc0 &&
+          marker <= 0xcf &&
+          marker != 0xc4 &&
+          marker != 0xc8 &&
+          marker != 0xcc) {
+        // Start of frame: precision, then height and width.
+        return [data.getUint16(offset + 7), data.getUint16(offset + 5)];
+      } else {
+        offset += 2 + data.getUint16(offset + 2);
+      }
+    }
+    return null;
+  }
+}
+
+class ImageTooLargeException implements Exception {
+  ImageTooLargeException(this.width, this.height);
+
+  final int width;
+  final int height;
+
+  @override
+  String toString() => 'ImageTooLargeException: ${width}x$height';
+}
+
+class _DecodeJob {
+  _DecodeJob(this.bytes, this.options, {required this.grayscale});
+
+  final Uint8List bytes;
+  final HtmlImageOptimizer options;
+  final bool grayscale;
+}
+
+class _Pixels {
+  _Pixels(this.rgba, this.width, this.height, {required this.opaque});
+
+  final Uint8List rgba;
+  final int width;
+  final int height;
+  final bool opaque;
+}
+
+_Pixels? _decode(_DecodeJob job) {
+  var image = img.decodeImage(job.bytes);
+  if (image == null) {
+    return null;
+  }
+  final pixels = image.width * image.height;
+  if (pixels > job.options.maxDecodedPixels) {
+    throw ImageTooLargeException(image.width, image.height);
+  }
+  if (pixels > job.options.maxPixels) {
+    final scale = math.sqrt(job.options.maxPixels / pixels);
+    image = img.copyResize(image,
+        width: math.max(1, (image.width * scale).floor()),
+        height: math.max(1, (image.height * scale).floor()),
+        interpolation: img.Interpolation.average);
+  }
+  // Decoders mostly yield 8-bit RGBA already, whose buffer is used as is.
+  if (image.format != img.Format.uint8 ||
+      image.numChannels != 4 ||
+      image.hasPalette) {
+    image = image.convert(format: img.Format.uint8, numChannels: 4, alpha: 255);
+  }
+  final rgba = image.toUint8List();
+  var opaque = true;
+  for (var i = 3; i < rgba.length; i += 4) {
+    if (rgba[i] != 255) {
+      opaque = false;
+      break;
+    }
+  }
+  if (job.grayscale) {
+    for (var i = 0; i < rgba.length; i += 4) {
+      final level = _luminance(rgba, i);
+      rgba[i] = level;
+      rgba[i + 1] = level;
+      rgba[i + 2] = level;
+    }
+  }
+  final threshold = job.options.bilevelThreshold;
+  if (opaque && threshold != null && _isBilevel(rgba, job.options)) {
+    for (var i = 0; i < rgba.length; i += 4) {
+      final level = _luminance(rgba, i) < threshold ? 0 : 255;
+      rgba[i] = level;
+      rgba[i + 1] = level;
+      rgba[i + 2] = level;
+    }
+  }
+  return _Pixels(rgba, image.width, image.height, opaque: opaque);
+}
+
+Uint8List? _grayJpeg(Uint8List bytes) {
+  final image = img.decodeJpg(bytes);
+  if (image == null) {
+    return null;
+  }
+  return img.encodeJpg(img.grayscale(image), quality: 90);
+}
+
+int _luminance(Uint8List rgba, int i) {
+  return (rgba[i] * 77 + rgba[i + 1] * 150 + rgba[i + 2] * 29) >> 8;
+}
+
+bool _isBilevel(Uint8List rgba, HtmlImageOptimizer options) {
+  final pixels = rgba.length ~/ 4;
+  final allowed = (pixels * (1 - options.bilevelRatio)).floor();
+  var other = 0;
+  for (var i = 0; i < rgba.length; i += 4) {
+    final r = rgba[i], g = rgba[i + 1], b = rgba[i + 2];
+    // Coloured pixels rule the image out however dark or light they are.
+    final chroma = math.max(r, math.max(g, b)) - math.min(r, math.min(g, b));
+    final luminance = _luminance(rgba, i);
+    if (chroma > 32 || (luminance > 48 && luminance < 208)) {
+      if (++other > allowed) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Already decoded pixels, embedded without a soft mask when opaque.
+class _PixelsImage extends ImageProvider {
+  _PixelsImage(this.pixels)
+      : super(pixels.width, pixels.height, PdfImageOrientation.topLeft, null);
+
+  final _Pixels pixels;
+
+  @override
+  PdfImage buildImage(Context context, {int? width, int? height}) {
+    return PdfImage(context.document,
+        image: pixels.rgba,
+        width: pixels.width,
+        height: pixels.height,
+        alpha: !pixels.opaque);
+  }
+}
@@ -0,0 +1,56 @@
+import 'conversion_metrics.dart';
+import 'conversion_scheduler.dart';
+import 'html_image_cache.dart';
+import 'html_to_widgets.dart';
+import 'pdf_text_writer.dart';
+import 'pdf_thumbnails.dart';
+
+/// Gives cached memory back when the system runs short.
+///
+/// Call [shrink] from `WidgetsBindingObserver.didHaveMemoryPressure`. Each
+/// call within [escalation] of the previous one frees more, cheapest to
+/// rebuild first: half the text layouts, then all of them, the emoji font
+/// and the page thumbnails, then every image cache, which means fetching
+/// images again. While memory is short the [scheduler], if any, refuses new
+/// large jobs.
+class HtmlMemoryPressure {
+  HtmlMemoryPressure._();
+
+  static final instance = HtmlMemoryPressure._();
+
+  static const maxLevel = 3;
+
+  Duration escalation = const Duration(seconds: 30);
+  ConversionScheduler? scheduler;
+
+  int _level = 0;
+  DateTime? _lastShrink;
+
+  /// Frees memory and returns the level reached, from 1 to [maxLevel].
+  int shrink() {
+    final now = DateTime.now();
+    final last = _lastShrink;
+    if (last == null || now.difference(last) > escalation) {
+      _level = 0;
+    }
+    _lastShrink = now;
+    if (_level < maxLevel) {
+      _level++;
+    }
+
+    final layouts = TextLayoutCache.instance;
+    layouts.trim(_level == 1 ? layouts.length ~/ 2 : 0);
+    if (_level >= 2) {
+      WidgetsHTMLDecoder.releaseEmoji();
+      PdfThumbnails.instance.clear();
+    }
+    if (_level >= 3) {
+      for (final cache in HtmlImageCache.live) {
+        cache.clear();
+      }
+    }
+    scheduler?.pauseLargeJobs(escalation);
+    ConversionMetrics.instance.shrink(_level);
+    return _level;
+  }
+}
@@ -0,0 +1,104 @@
+import 'dart:typed_data';
+
+import 'package:printing/printing.dart';
+
+import '../htmltopdfwidgets.dart';
+import 'html_to_widgets.dart';
+
+/// Header, footer and letterhead repeated on every page.
+///
+/// Each part is converted once per document, or once for a whole batch, and
+/// the same widgets are reused on every page. The letterhead is rasterized
+/// once and embedded as a single image that all pages refer to.
+class HtmlPageTemplate {
+  const HtmlPageTemplate({
+    this.header,
+    this.footer,
+    this.letterhead,
+    this.letterheadDpi = 150,
+    this.pageNumbers = false,
+  });
+
+  final String? header;
+  final String? footer;
+
+  /// A PDF whose first page is drawn behind every page, scaled to fit
+  /// without stretching when its size differs from the page format.
+  final Uint8List? letterhead;
+  final double letterheadDpi;
+
+  /// Whether to print `page / pages` under the footer.
+  final bool pageNumbers;
+}
+
+/// Converts templates for [HTMLToPdf], which is the only caller: like
+/// [HtmlPageLayout], this is not exported.
+extension HtmlPageTemplateResolver on HtmlPageTemplate {
+  Future<HtmlPageLayout> resolve(
+      WidgetsHTMLDecoder decoder, PdfPageFormat pageFormat) async {
+    ImageProvider? background;
+    if (letterhead != null) {
+      final raster = await Printing.raster(letterhead!,
+              pages: [0], dpi: letterheadDpi)
+          .first;
+      background = MemoryImage(await raster.toPng());
+    }
+    return HtmlPageLayout(
+      pageFormat,
+      header: header == null ? null : await decoder.convert(header!),
+      footer: footer == null ? null : await decoder.convert(footer!),
+      background: background,
+      pageNumbers: pageNumbers,
+    );
+  }
+}
+
+/// A resolved [HtmlPageTemplate], ready to decorate any number of pages.
+class HtmlPageLayout {
+  const HtmlPageLayout(
+    this.pageFormat, {
+    this.header,
+    this.footer,
+    this.background,
+    this.pageNumbers = false,
+  });
+
+  final PdfPageFormat pageFormat;
+  final List<Widget>? header;
+  final List<Widget>? footer;
+  final ImageProvider? background;
+  final bool pageNumbers;
+
+  MultiPage build(List<Widget> widgets, {required int maxPages}) {
+    return MultiPage(
+      pageTheme: PageTheme(
+        pageFormat: pageFormat,
+        buildBackground: background == null
+            ? null
+            : (context) => FullPage(
+                ignoreMargins: true,
+                child: Image(background!, fit: BoxFit.contain)),
+      ),
+      maxPages: maxPages,
+      header: header == null
+          ? null
+          : (context) => Column(
+              crossAxisAlignment: CrossAxisAlignment.start,
+              children: header!),
+      footer: footer == null && !pageNumbers
+          ? null
+          : (context) => Column(
+                crossAxisAlignment: CrossAxisAlignment.start,
+                children: [
+                  ...?footer,
+                  if (pageNumbers)
+                    Align(
+                        alignment: Alignment.centerRight,
+                        child: Text(
+                            '${context.pageNumber} / ${context.pagesCount}')),
+                ],
+              ),
+      build: (context) => widgets,
+    );
+  }
+}
@@ -0,0 +1,281 @@
+import 'dart:collection';
+
+import 'package:html/dom.dart' as dom;
+import 'package:html/parser.dart' show parse;
+
+import '../htmltopdfwidgets.dart';
+import 'html_to_widgets.dart';
+import 'html_whitespace.dart';
+
+enum HtmlTextBlockType {
+  paragraph,
+  heading,
+  bulletedList,
+  numberList,
+  quote,
+
+  /// Preformatted text, held verbatim in a single run.
+  code,
+}
+
+/// A piece of text sharing a single style.
+class HtmlTextRun {
+  const HtmlTextRun(this.text, this.style);
+
+  /// Stands in for `<br>` inside [text].
+  static const lineBreak = '\u2028';
+
+  final String text;
+  final TextStyle style;
+}
+
+/// A block of flowing text, as laid out by [PdfTextWriter].
+class HtmlTextBlock {
+  const HtmlTextBlock(this.type, this.runs, {this.index});
+
+  final HtmlTextBlockType type;
+  final List<HtmlTextRun> runs;
+
+  /// Position in its list for [HtmlTextBlockType.numberList].
+  final int? index;
+}
+
+/// Converts html made only of paragraphs, headings, quotes and lists into
+/// styled runs, without building any widgets.
+class TextBlocksHTMLDecoder {
+  TextBlocksHTMLDecoder({this.grayscale = false});
+
+  /// Turns span colours into gray levels.
+  final bool grayscale;
+
+  /// Runs of formatting subtrees already converted, by parent style and
+  /// markup. Runs are immutable, so exact repeats share the same instances.
+  final _formattingRuns =
+      LinkedHashMap<TextStyle, Map<String, List<HtmlTextRun>>>.identity();
+
+  static const _maxInlineDepth = 64;
+  static const _maxBlockDepth = 64;
+
+  static const _blockElements = [
+    HTMLTags.h1,
+    HTMLTags.h2,
+    HTMLTags.h3,
+    HTMLTags.paragraph,
+    HTMLTags.div,
+    HTMLTags.unorderedList,
+    HTMLTags.orderedList,
+    HTMLTags.list,
+    HTMLTags.blockQuote,
+    HTMLTags.pre,
+  ];
+
+  /// Returns null if [html] contains anything else, such as images, so that
+  /// the caller can fall back to [WidgetsHTMLDecoder].
+  Future<List<HtmlTextBlock>?> convert(String html) async {
+    final blocks = <HtmlTextBlock>[];
+    final body = parse(html).body;
+    if (body == null) {
+      return blocks;
+    }
+    try {
+      await _parseBlockChildren(body, const TextStyle(), blocks);
+    } on _UnsupportedElement {
+      return null;
+    }
+    return blocks;
+  }
+
+  Future<void> _parseBlockChildren(
+      dom.Element element, TextStyle style, List<HtmlTextBlock> blocks,
+      {int depth = 0}) async {
+    if (depth > _maxBlockDepth) {
+      // Like inline markup, deeply nested blocks go through the widget
+      // decoder, which flattens them without recursion.
+      throw _UnsupportedElement();
+    }
+    var runs = <HtmlTextRun>[];
+    for (final child in element.nodes) {
+      if (child is dom.Element && _blockElements.contains(child.localName)) {
+        _addParagraph(runs, blocks);
+        runs = <HtmlTextRun>[];
+        await _parseBlockElement(child, style, blocks, depth: depth);
+      } else {
+        _parseInlineNode(child, style, runs);
+      }
+    }
+    _addParagraph(runs, blocks);
+  }
+
+  Future<void> _parseBlockElement(
+      dom.Element element, TextStyle style, List<HtmlTextBlock> blocks,
+      {int depth = 0}) async {
+    switch (element.localName) {
+      case HTMLTags.h1:
+      case HTMLTags.h2:
+      case HTMLTags.h3:
+        final level = int.parse(element.localName!.substring(1));
+        final headingStyle = style.copyWith(
+            fontSize: await WidgetsHTMLDecoder.getHeadingSize(level),
+            fontWeight: FontWeight.bold);
+        blocks.add(HtmlTextBlock(
+            HtmlTextBlockType.heading, _parseRuns(element, headingStyle)));
+        break;
+      case HTMLTags.unorderedList:
+        for (final child in element.children) {
+          blocks.add(_parseListElement(child, style,
+              type: HtmlTextBlockType.bulletedList));
+        }
+        break;
+      case HTMLTags.orderedList:
+        for (var i = 0; i < element.children.length; i++) {
+          blocks.add(_parseListElement(element.children[i], style,
+              type: HtmlTextBlockType.numberList, index: i + 1));
+        }
+        break;
+      case HTMLTags.list:
+        blocks.add(_parseListElement(element, style,
+            type: HtmlTextBlockType.bulletedList));
+        break;
+      case HTMLTags.blockQuote:
+        for (final child in element.nodes) {
+          final runs = <HtmlTextRun>[];
+          if (child is dom.Element) {
+            runs.addAll(_parseRuns(child, style));
+          } else {
+            _parseInlineNode(child, style, runs);
+          }
+          if (!_isBlank(runs)) {
+            blocks.add(HtmlTextBlock(HtmlTextBlockType.quote, runs));
+          }
+        }
+        break;
+      case HTMLTags.pre:
+        // Markup inside, such as highlighting spans, is dropped like in
+        // the widget decoder; only the text and its white space remain.
+        blocks.add(HtmlTextBlock(HtmlTextBlockType.code, [
+          HtmlTextRun(WidgetsHTMLDecoder.textOf(element),
+              style.copyWith(fontSize: WidgetsHTMLDecoder.codeFontSize))
+        ]));
+        break;
+      default:
+        await _parseBlockChildren(element, style, blocks, depth: depth + 1);
+    }
+  }
+
+  HtmlTextBlock _parseListElement(dom.Element element, TextStyle style,
+      {required HtmlTextBlockType type, int? index}) {
+    if (element.localName != HTMLTags.list) {
+      throw _UnsupportedElement();
+    }
+    return HtmlTextBlock(type, _parseRuns(element, style), index: index);
+  }
+
+  List<HtmlTextRun> _parseRuns(dom.Element element, TextStyle style) {
+    final runs = <HtmlTextRun>[];
+    for (final child in element.nodes) {
+      _parseInlineNode(child, style, runs);
+    }
+    return runs;
+  }
+
+  void _parseInlineNode(dom.Node node, TextStyle style, List<HtmlTextRun> runs,
+      {int depth = 0}) {
+    if (node is dom.Text) {
+      runs.add(HtmlTextRun(node.text, style));
+    } else if (node is dom.Element) {
+      final localName = node.localName;
+      if (localName == HTMLTags.lineBreak) {
+        runs.add(HtmlTextRun(HtmlTextRun.lineBreak, style));
+      } else if (depth > _maxInlineDepth) {
+        // Pathologically nested markup goes through the widget decoder,
+        // which walks formatting subtrees without recursion.
+        throw _UnsupportedElement();
+      } else if (HTMLTags.formattingElements.contains(localName)) {
+        // Only outermost subtrees are looked up, keying every level would
+        // make nested markup quadratic.
+        final cache =
+            depth == 0 ? _formattingRuns.putIfAbsent(style, () => {}) : null;
+        final key = cache == null
+            ? null
+            : WidgetsHTMLDecoder.subtreeKey(node, withText: true);
+        var childRuns = cache?[key];
+        if (childRuns == null) {
+          final childStyle = _parseFormattingElementStyle(node, style);
+          childRuns = <HtmlTextRun>[];
+          for (final child in node.nodes) {
+            _parseInlineNode(child, childStyle, childRuns, depth: depth + 1);
+          }
+          cache?[key!] = childRuns;
+        }
+        runs.addAll(childRuns);
+      } else {
+        throw _UnsupportedElement();
+      }
+    }
+  }
+
+  TextStyle _parseFormattingElementStyle(dom.Element element, TextStyle style) {
+    switch (element.localName) {
+      case HTMLTags.bold:
+      case HTMLTags.strong:
+        return style.copyWith(fontWeight: FontWeight.bold);
+      case HTMLTags.em:
+      case HTMLTags.italic:
+        return style.copyWith(fontStyle: FontStyle.italic);
+      case HTMLTags.underline:
+        return _decorate(style, TextDecoration.underline);
+      case HTMLTags.del:
+        return _decorate(style, TextDecoration.lineThrough);
+      case HTMLTags.span:
+        var deltaAttributes =
+            WidgetsHTMLDecoder.getDeltaAttributesFromHtmlAttributes(
+                element.attributes);
+        if (grayscale) {
+          deltaAttributes = WidgetsHTMLDecoder.toGrayscale(deltaAttributes);
+        }
+        return _decorate(style.merge(deltaAttributes),
+            deltaAttributes.decoration,
+            base: style.decoration);
+      case HTMLTags.anchor:
+        if (element.attributes['href'] != null) {
+          return _decorate(style, TextDecoration.underline);
+        }
+        return style;
+      default:
+        return style;
+    }
+  }
+
+  static TextStyle _decorate(TextStyle style, TextDecoration? decoration,
+      {TextDecoration? base}) {
+    base ??= style.decoration;
+    if (decoration == null) {
+      return style;
+    }
+    return style.copyWith(
+        decoration: TextDecoration.combine(
+            [if (base != null) base, decoration]));
+  }
+
+  static void _addParagraph(
+      List<HtmlTextRun> runs, List<HtmlTextBlock> blocks) {
+    if (!_isBlank(runs)) {
+      blocks.add(HtmlTextBlock(HtmlTextBlockType.paragraph, runs));
+    }
+  }
+
+  /// Whether [runs] hold nothing but collapsible whitespace; non-breaking
+  /// spaces count as content, so `<p>&nbsp;</p>` still takes up a line.
+  static bool _isBlank(List<HtmlTextRun> runs) {
+    for (final run in runs) {
+      for (final c in run.text.codeUnits) {
+        if (!HtmlWhitespace.isCollapsibleSpace(c)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+class _UnsupportedElement implements Exception {}
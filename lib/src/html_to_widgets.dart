@@ -3,46 +3,131 @@ import 'dart:ui';
 import 'package:html/parser.dart' show parse;
 import 'package:html/dom.dart' as dom;
 import 'package:htmltopdfwidgets/src/attributes.dart';
+import 'package:htmltopdfwidgets/src/converter_config.dart';
+import 'package:htmltopdfwidgets/src/html_whitespace.dart';
 import 'package:printing/printing.dart';
 
 import '../htmltopdfwidgets.dart';
 
+/// Converts html to widgets for one job.
+///
+/// The shared [config] is only read; the fallback fonts of this job are kept
+/// on the decoder itself.
 class WidgetsHTMLDecoder {
-  final Font? font;
+  final ConverterConfig config;
   final List<Font> fontFallback;
-  const WidgetsHTMLDecoder({this.font, required this.fontFallback});
+  WidgetsHTMLDecoder(this.config) : fontFallback = [...config.fontFallback];
+
+  Font? get font => config.defaultFont;
+
+  /// Size of preformatted text, smaller than body text as in browsers.
+  static const codeFontSize = 10.0;
+
+  /// Per decoder, since a font holds on to the document it was last used
+  /// in.
+  final _monospace = Font.courier();
+
+  static Future<Font>? _emoji;
+
+  static Future<Font> _loadEmoji() {
+    final cached = _emoji;
+    if (cached != null) {
+      return cached;
+    }
+    final emoji = PdfGoogleFonts.notoColorEmoji();
+    _emoji = emoji;
+    emoji.then((_) {}, onError: (Object e) {
+      _emoji = null;
+    });
+    return emoji;
+  }
+
+  /// Drops the emoji font; it is downloaded again when next needed.
+  static void releaseEmoji() {
+    _emoji = null;
+  }
+
+  /// Whether [text] has characters that only the emoji font covers: the
+  /// blocks holding emoji, and the scattered symbols with an emoji
+  /// presentation, such as ‼, ↔, ▪, ⤴, 〰 and ㊗.
+  static bool containsEmoji(String text) {
+    for (final rune in text.runes) {
+      if ((rune >= 0x1f000 && rune <= 0x1faff) ||
+          (rune >= 0x2190 && rune <= 0x21ff) ||
+          (rune >= 0x2300 && rune <= 0x23ff) ||
+          (rune >= 0x25a0 && rune <= 0x27bf) ||
+          (rune >= 0x2900 && rune <= 0x297f) ||
+          (rune >= 0x2b00 && rune <= 0x2bff) ||
+          rune == 0x203c ||
+          rune == 0x2049 ||
+          rune == 0x2139 ||
+          rune == 0x24c2 ||
+          rune == 0x3030 ||
+          rune == 0x303d ||
+          rune == 0x3297 ||
+          rune == 0x3299 ||
+          rune == 0x20e3 ||
+          rune == 0xfe0f) {
+        return true;
+      }
+    }
+    return false;
+  }
 
   Future<List<Widget>> convert(
     String html,
   ) async {
-    final emoji = await PdfGoogleFonts.notoColorEmoji();
-    fontFallback.add(emoji);
+    return await convertBlocks(html).toList();
+  }
+
+  /// Converts [html] one top-level block at a time.
+  ///
+  /// Cancelling the subscription stops the conversion at the next block, so
+  /// nothing after it is parsed and none of its images are fetched.
+  ///
+  /// With [prefetchImages], the images of the document are fetched into the
+  /// config's image cache as soon as it is parsed, [maxImagePrefetches] at
+  /// a time, so that the downloads overlap with converting the blocks
+  /// before them.
+  Stream<Widget> convertBlocks(
+    String html, {
+    bool prefetchImages = false,
+  }) async* {
     final document = parse(html);
     final body = document.body;
     if (body == null) {
-      return [];
+      return;
+    }
+    if (prefetchImages && config.imageCache != null) {
+      _prefetchImages(body).ignore();
     }
-    List<Widget> nodes = await _parseElement(
+    // The colour emoji font weighs about 10 MB, only pay for it when the
+    // document actually contains emoji.
+    if (containsEmoji(textOf(body))) {
+      final emoji = await _loadEmoji();
+      if (!fontFallback.contains(emoji)) {
+        fontFallback.add(emoji);
+      }
+    }
+    yield* _parseElement(
       body.nodes,
     );
-
-    return nodes;
   }
 
-  Future<List<Widget>> _parseElement(
+  Stream<Widget> _parseElement(
     Iterable<dom.Node> domNodes,
-  ) async {
+  ) async* {
     final List<Widget> delta = [];
-    final result = <Widget>[];
     for (final domNode in domNodes) {
       if (domNode is dom.Element) {
         final localName = domNode.localName;
         if (HTMLTags.formattingElements.contains(localName)) {
-          final attributes = await _parserFormattingElementAttributes(domNode);
+          final attributes = _formattingElementAttributes(domNode);
 
-          result.add(Text(domNode.text, style: attributes));
+          yield Text(HtmlWhitespace.collapse(textOf(domNode), afterSpace: true),
+              style: attributes);
         } else if (HTMLTags.specialElements.contains(localName)) {
-          result.addAll(
+          yield* Stream.fromIterable(
             await _parseSpecialElements(
               domNode,
               type: BuiltInAttributeKey.bulletedList,
@@ -50,16 +135,21 @@ class WidgetsHTMLDecoder {
           );
         }
       } else if (domNode is dom.Text) {
-        delta.add(Text(domNode.text,
-            style: TextStyle(font: font, fontFallback: fontFallback)));
+        // White space between blocks, and at the start of a line, is not
+        // rendered.
+        final text =
+            HtmlWhitespace.collapse(domNode.text, afterSpace: delta.isEmpty);
+        if (text.isNotEmpty) {
+          delta.add(Text(text,
+              style: TextStyle(font: font, fontFallback: fontFallback)));
+        }
       } else {
         assert(false, 'Unknown node type: $domNode');
       }
     }
     if (delta.isNotEmpty) {
-      result.add(Wrap(children: delta));
+      yield Wrap(children: delta);
     }
-    return result;
   }
 
   Future<Iterable<Widget>> _parseSpecialElements(
@@ -84,13 +174,15 @@ class WidgetsHTMLDecoder {
           type: type,
         );
       case HTMLTags.paragraph:
-        return [await _parseParagraphElement(element)];
+        return await _parseParagraphElement(element);
       case HTMLTags.blockQuote:
         return await _parseBlockQuoteElement(element);
       case HTMLTags.image:
         return [await _parseImageElement(element)];
+      case HTMLTags.pre:
+        return _parsePreElement(element);
       default:
-        return [await _parseParagraphElement(element)];
+        return await _parseParagraphElement(element);
     }
   }
 
@@ -98,12 +190,42 @@ class WidgetsHTMLDecoder {
     return Text(text);
   }
 
-  Future<TextStyle> _parserFormattingElementAttributes(
-      dom.Element element) async {
-    final localName = element.localName;
+  TextStyle _formattingElementAttributes(dom.Element element) {
+    final style = _parserFormattingElementAttributes(element);
+    return config.grayscale ? toGrayscale(style) : style;
+  }
 
+  /// Reused by the iterative walks below; they never yield, so one stack is
+  /// enough however many conversions are in flight.
+  static final _elementStack = <dom.Element>[];
+
+  /// Merges the styles of [element] and all of its descendants.
+  ///
+  /// The subtree is walked in document order with an explicit stack rather
+  /// than by recursion, so the cost stays linear and deeply nested markup
+  /// cannot overflow the stack.
+  TextStyle _parserFormattingElementAttributes(dom.Element element) {
     TextStyle attributes = TextStyle(fontFallback: fontFallback, font: font);
     final List<TextDecoration> decoration = [];
+    final stack = _elementStack..clear();
+    stack.add(element);
+    while (stack.isNotEmpty) {
+      final current = stack.removeLast();
+      attributes =
+          _parseFormattingElementStyle(current, attributes, decoration);
+      final children = current.children;
+      for (var i = children.length - 1; i >= 0; i--) {
+        stack.add(children[i]);
+      }
+    }
+
+    return attributes.copyWith(decoration: TextDecoration.combine(decoration));
+  }
+
+  TextStyle _parseFormattingElementStyle(dom.Element element,
+      TextStyle attributes, List<TextDecoration> decoration) {
+    final localName = element.localName;
+
     switch (localName) {
       case HTMLTags.bold:
         attributes = attributes.copyWith(fontWeight: FontWeight.bold);
@@ -126,7 +248,7 @@ class WidgetsHTMLDecoder {
         break;
 
       case HTMLTags.span:
-        final deltaAttributes = _getDeltaAttributesFromHtmlAttributes(
+        final deltaAttributes = getDeltaAttributesFromHtmlAttributes(
           element.attributes,
         );
         attributes = attributes.merge(deltaAttributes);
@@ -140,46 +262,81 @@ class WidgetsHTMLDecoder {
           decoration.add(TextDecoration.underline);
         }
         break;
-      case HTMLTags.paragraph:
-        attributes = attributes;
-        break;
-      case HTMLTags.code:
-        attributes = attributes;
-        break;
       default:
         break;
     }
+    return attributes;
+  }
 
-    for (final child in element.children) {
-      final nattributes = await _parserFormattingElementAttributes(child);
-      attributes = attributes.merge(nattributes);
-      if (nattributes.decoration != null) {
-        decoration.add(nattributes.decoration!);
+  /// Text of [node] and all of its descendants, gathered without recursion.
+  static String textOf(dom.Node node) {
+    if (node is dom.Text) {
+      return node.data;
+    }
+    final text = StringBuffer();
+    final stack = <dom.Node>[node];
+    while (stack.isNotEmpty) {
+      final current = stack.removeLast();
+      if (current is dom.Text) {
+        text.write(current.data);
+      } else {
+        final nodes = current.nodes;
+        for (var i = nodes.length - 1; i >= 0; i--) {
+          stack.add(nodes[i]);
+        }
       }
     }
+    return text.toString();
+  }
 
-    return attributes.copyWith(decoration: TextDecoration.combine(decoration));
+  /// A key for the markup of [element] that only keeps what affects its
+  /// style: tags, inline styles and links, plus the text if [withText].
+  ///
+  /// Every value is prefixed with its length, so that no text or style can
+  /// be mistaken for markup.
+  static String subtreeKey(dom.Element element, {bool withText = false}) {
+    final key = StringBuffer();
+    final stack = <dom.Node?>[element];
+    while (stack.isNotEmpty) {
+      final current = stack.removeLast();
+      if (current == null) {
+        key.write('>');
+      } else if (current is dom.Element) {
+        _writeField(key, '<', current.localName ?? '');
+        final style = current.attributes['style'];
+        if (style != null) {
+          _writeField(key, 's', style);
+        }
+        if (current.attributes.containsKey('href')) {
+          key.write('h');
+        }
+        stack.add(null);
+        final nodes = current.nodes;
+        for (var i = nodes.length - 1; i >= 0; i--) {
+          stack.add(nodes[i]);
+        }
+      } else if (withText && current is dom.Text) {
+        _writeField(key, '"', current.data);
+      }
+    }
+    return key.toString();
+  }
+
+  static void _writeField(StringBuffer key, String tag, String value) {
+    key
+      ..write(tag)
+      ..write(value.length)
+      ..write(':')
+      ..write(value);
   }
 
   Future<Widget> _parseHeadingElement(
     dom.Element element, {
     required int level,
   }) async {
-    final delta = <TextSpan>[];
-    final children = element.nodes.toList();
-    for (final child in children) {
-      if (child is dom.Element) {
-        final attributes = await _parserFormattingElementAttributes(child);
-        delta.add(TextSpan(text: child.text, style: attributes));
-      } else {
-        delta.add(TextSpan(
-            text: child.text,
-            style: TextStyle(font: font, fontFallback: fontFallback)));
-      }
-    }
     return RichText(
         text: TextSpan(
-            children: delta,
+            children: _parseSpans(element.nodes),
             style: TextStyle(
                 fontSize: await getHeadingSize(level),
                 fontWeight: FontWeight.bold)));
@@ -242,16 +399,70 @@ class WidgetsHTMLDecoder {
     }
   }
 
-  Future<Widget> _parseParagraphElement(dom.Element element) async {
-    final delta = await _parseDeltaElement(element);
-    return delta;
+  Future<List<Widget>> _parseParagraphElement(dom.Element element) async {
+    return _parseBlockContent(element);
+  }
+
+  /// One [Text] per line of monospace text, with white space kept, so that
+  /// long listings break across pages between any two lines.
+  List<Widget> _parsePreElement(dom.Element element) {
+    final style = TextStyle(
+        font: _monospace, fontSize: codeFontSize, fontFallback: fontFallback);
+    return [
+      for (final line in HtmlWhitespace.preformatted(textOf(element)))
+        // An empty line still takes up the height of one.
+        Text(line.isEmpty ? ' ' : line, style: style)
+    ];
+  }
+
+  /// Image fetches a conversion starts ahead of the blocks being converted.
+  static int maxImagePrefetches = 6;
+
+  Future<void> _prefetchImages(dom.Element body) async {
+    final sources = body
+        .getElementsByTagName(HTMLTags.image)
+        .map((image) => image.attributes['src'])
+        .whereType<String>()
+        .toSet()
+        .iterator;
+    Future<void> fetchNext() async {
+      while (sources.moveNext()) {
+        try {
+          await _resolveImage(sources.current);
+        } catch (_) {
+          // Dropped by the cache and reported when the image is converted.
+        }
+      }
+    }
+
+    await Future.wait(
+        [for (var i = 0; i < maxImagePrefetches; i++) fetchNext()]);
+  }
+
+  HtmlImageOptimizer? get _imageOptimizer =>
+      config.imageOptimizer ??
+      (config.grayscale ? const HtmlImageOptimizer() : null);
+
+  /// Fetches [src] through the config's image cache, if any. Configs with
+  /// other optimizer or grayscale settings get their own cache entries.
+  Future<ImageProvider> _resolveImage(String src) {
+    final variant = '${_imageOptimizer?.cacheKey}/${config.grayscale}';
+    return config.imageCache?.resolve(src, _fetchImage, variant) ??
+        _fetchImage(src);
+  }
+
+  Future<ImageProvider> _fetchImage(String src) async {
+    final image = await (config.imageResolver ?? networkImage)(src);
+    return await (_imageOptimizer?.optimize(image,
+            grayscale: config.grayscale) ??
+        image);
   }
 
   Future<Widget> _parseImageElement(dom.Element element) async {
     final src = element.attributes["src"];
     try {
       if (src != null) {
-        final netImage = await networkImage(src);
+        final netImage = await _resolveImage(src);
         return Image(netImage);
       } else {
         return Text("");
@@ -261,20 +472,87 @@ class WidgetsHTMLDecoder {
     }
   }
 
+  /// The content of [element] as a single widget, see [_parseBlockContent].
   Future<Widget> _parseDeltaElement(dom.Element element) async {
-    final delta = <Widget>[];
-    final children = element.nodes.toList();
-    for (final child in children) {
-      if (child is dom.Element) {
-        final attributes = await _parserFormattingElementAttributes(child);
+    final content = _parseBlockContent(element);
+    if (content.length == 1) {
+      return content.single;
+    }
+    return Column(
+        crossAxisAlignment: CrossAxisAlignment.start, children: content);
+  }
+
+  /// One [RichText] per run of inline content rather than a [Text] per
+  /// run: its spans are painted in a single pass that only changes the fill
+  /// colour when it differs, and its words flow across runs like the source
+  /// text.
+  ///
+  /// A `<pre>` anywhere in [element] keeps its lines and white space: the
+  /// elements around it are walked into, without recursion, instead of
+  /// being flattened into collapsed text.
+  List<Widget> _parseBlockContent(dom.Element element) {
+    if (element.localName == HTMLTags.pre) {
+      return _parsePreElement(element);
+    }
+    final containers = <dom.Node>{};
+    for (final pre in element.getElementsByTagName(HTMLTags.pre)) {
+      for (var node = pre.parent;
+          node != null && !identical(node, element);
+          node = node.parent) {
+        containers.add(node);
+      }
+    }
+    final result = <Widget>[];
+    final inline = <dom.Node>[];
+    void flush() {
+      if (inline.isNotEmpty) {
+        result.add(RichText(text: TextSpan(children: _parseSpans(inline))));
+        inline.clear();
+      }
+    }
+
+    final stack = element.nodes.reversed.toList();
+    while (stack.isNotEmpty) {
+      final node = stack.removeLast();
+      if (node is dom.Element && node.localName == HTMLTags.pre) {
+        flush();
+        result.addAll(_parsePreElement(node));
+      } else if (containers.contains(node)) {
+        flush();
+        stack.addAll(node.nodes.reversed);
+      } else {
+        inline.add(node);
+      }
+    }
+    flush();
+    if (result.isEmpty) {
+      result.add(RichText(text: TextSpan(children: [])));
+    }
+    return result;
+  }
 
-        delta.add(Text(child.text, style: attributes));
+  /// Spans of [nodes], with white space collapsed across them as a browser
+  /// would.
+  List<TextSpan> _parseSpans(Iterable<dom.Node> nodes) {
+    final delta = <TextSpan>[];
+    var afterSpace = true;
+    for (final child in nodes) {
+      final TextStyle style;
+      final String raw;
+      if (child is dom.Element) {
+        style = _formattingElementAttributes(child);
+        raw = textOf(child);
       } else {
-        delta.add(Text(child.text ?? "",
-            style: TextStyle(font: font, fontFallback: fontFallback)));
+        style = TextStyle(font: font, fontFallback: fontFallback);
+        raw = child.text ?? "";
+      }
+      final text = HtmlWhitespace.collapse(raw, afterSpace: afterSpace);
+      if (text.isNotEmpty) {
+        afterSpace = text.codeUnitAt(text.length - 1) == 0x20;
+        delta.add(TextSpan(text: text, style: style));
       }
     }
-    return Wrap(children: delta);
+    return delta;
   }
 
   static Map<String, String> _cssStringToMap(String? cssString) {
@@ -295,7 +573,7 @@ class WidgetsHTMLDecoder {
     return result;
   }
 
-  static TextStyle _getDeltaAttributesFromHtmlAttributes(
+  static TextStyle getDeltaAttributesFromHtmlAttributes(
       LinkedHashMap<Object, String> htmlAttributes) {
     TextStyle style = const TextStyle();
     final styleString = htmlAttributes["style"];
@@ -333,6 +611,26 @@ class WidgetsHTMLDecoder {
     return style;
   }
 
+  /// Replaces the text and decoration colours of [style] by their gray
+  /// level.
+  static TextStyle toGrayscale(TextStyle style) {
+    final color = style.color;
+    final decorationColor = style.decorationColor;
+    if (color == null && decorationColor == null) {
+      return style;
+    }
+    return style.copyWith(
+        color: color == null ? null : _gray(color),
+        decorationColor:
+            decorationColor == null ? null : _gray(decorationColor));
+  }
+
+  static PdfColor _gray(PdfColor color) {
+    return PdfColorGrey(
+        0.299 * color.red + 0.587 * color.green + 0.114 * color.blue,
+        color.alpha);
+  }
+
   static TextStyle _assignTextDecorations(
       TextStyle style, String decorationStr) {
     final decorations = decorationStr.split(" ");
@@ -447,9 +745,11 @@ class HTMLTags {
   static const checkbox = 'input';
   static const span = 'span';
   static const code = 'code';
+  static const pre = 'pre';
   static const blockQuote = 'blockquote';
   static const div = 'div';
   static const divider = 'hr';
+  static const lineBreak = 'br';
 
   static List<String> formattingElements = [
     HTMLTags.anchor,
@@ -474,7 +774,8 @@ class HTMLTags {
     HTMLTags.paragraph,
     HTMLTags.blockQuote,
     HTMLTags.checkbox,
-    HTMLTags.image
+    HTMLTags.image,
+    HTMLTags.pre,
   ];
 
   static bool isTopLevel(String tag) {
@@ -484,7 +785,8 @@ class HTMLTags {
         tag == checkbox ||
         tag == paragraph ||
         tag == div ||
-        tag == blockQuote;
+        tag == blockQuote ||
+        tag == pre;
   }
 }
 
@@ -1,17 +1,245 @@
+import 'dart:async';
+import 'dart:typed_data';
+
 import '../htmltopdfwidgets.dart';
+import 'conversion_metrics.dart';
+import 'converter_config.dart';
+import 'html_image_cache.dart';
+import 'html_page_template.dart';
+import 'html_to_text_blocks.dart';
 import 'html_to_widgets.dart';
+import 'pdf_text_writer.dart';
 
 class HTMLToPdf extends HtmlCodec {
+  /// One converter, and its [config], can serve any number of concurrent
+  /// conversions. [fontFallback] and [defaultFont] given to a single call
+  /// override the config for that call only.
+  const HTMLToPdf({this.config = ConverterConfig.empty});
+
+  final ConverterConfig config;
+
+  ConverterConfig _config(List<Font>? fontFallback, Font? defaultFont) {
+    if (fontFallback == null && defaultFont == null) {
+      return config;
+    }
+    return config.copyWith(
+        fontFallback: fontFallback, defaultFont: defaultFont);
+  }
+
   @override
   Future<List<Widget>> convert(String html,
       {List<Font>? fontFallback, Font? defaultFont}) async {
     final widgetDecoder =
-        WidgetsHTMLDecoder(fontFallback: fontFallback ?? [], font: defaultFont);
-    return await widgetDecoder.convert(html);
+        WidgetsHTMLDecoder(_config(fontFallback, defaultFont));
+    ConversionMetrics.instance.bytesIn += html.length;
+    return await ConversionMetrics.instance
+        .time('convert', () => widgetDecoder.convert(html));
+  }
+
+  /// Converts [html] block by block, see [WidgetsHTMLDecoder.convertBlocks].
+  Stream<Widget> convertBlocks(String html,
+      {List<Font>? fontFallback, Font? defaultFont}) {
+    final widgetDecoder =
+        WidgetsHTMLDecoder(_config(fontFallback, defaultFont));
+    return widgetDecoder.convertBlocks(html);
+  }
+
+  /// Renders only the first [pages] pages of [html] for a quick preview.
+  ///
+  /// Blocks are measured as they are converted and the conversion is
+  /// abandoned once the pages are filled, so the rest of the document is
+  /// never parsed, laid out or fetched. Blocks that cannot be split across
+  /// pages and are taller than one, such as big images, are clipped to a
+  /// page, and so is a first block too long for [pages] pages.
+  Future<Uint8List> preview(String html,
+      {int pages = 1,
+      PdfPageFormat pageFormat = PdfPageFormat.a4,
+      List<Font>? fontFallback,
+      Font? defaultFont}) async {
+    ConversionMetrics.instance.bytesIn += html.length;
+    final stopwatch = Stopwatch()..start();
+    final maxHeight = pageFormat.availableHeight * pages;
+    final constraints = BoxConstraints(maxWidth: pageFormat.availableWidth);
+
+    var document = Document();
+    final context =
+        Context(document: document.document).inheritFrom(ThemeData.base());
+    final blocks = <Widget>[];
+    var height = 0.0;
+    await for (var block in convertBlocks(html,
+        fontFallback: fontFallback, defaultFont: defaultFont)) {
+      block.layout(context, constraints, parentUsesSize: true);
+      var blockHeight = block.box!.height;
+      if (blockHeight > pageFormat.availableHeight &&
+          (block is! SpanningWidget || !block.canSpan)) {
+        // MultiPage refuses such a block outright.
+        block = _clip(block, pageFormat);
+        blockHeight = pageFormat.availableHeight;
+      }
+      height += blockHeight;
+      if (height > maxHeight && blocks.isNotEmpty) {
+        break;
+      }
+      blocks.add(block);
+    }
+
+    // Page breaks can push a block further down than its measured height,
+    // drop trailing blocks until the preview fits.
+    Uint8List bytes;
+    while (true) {
+      try {
+        document.addPage(MultiPage(
+            pageFormat: pageFormat,
+            maxPages: pages,
+            build: (context) => blocks));
+        bytes = await document.save();
+        break;
+      } on TooManyPagesException {
+        document = Document();
+        if (blocks.length <= 1) {
+          document.addPage(_clippedPage(blocks.single, pageFormat));
+          bytes = await document.save();
+          break;
+        }
+        blocks.removeLast();
+      }
+    }
+    ConversionMetrics.instance
+      ..record('preview', stopwatch.elapsed)
+      ..bytesOut += bytes.length;
+    return bytes;
+  }
+
+  /// A single page showing the top of [block], however long it is.
+  static Page _clippedPage(Widget block, PdfPageFormat pageFormat) {
+    return Page(
+        pageFormat: pageFormat, build: (context) => _clip(block, pageFormat));
+  }
+
+  /// The top of [block], one page high.
+  static Widget _clip(Widget block, PdfPageFormat pageFormat) {
+    return SizedBox(
+        height: pageFormat.availableHeight, child: ClipRect(child: block));
+  }
+
+  /// Renders [html] straight to PDF, without building widgets, when it is
+  /// made only of paragraphs, headings, quotes, lists and preformatted
+  /// text.
+  ///
+  /// Anything else, or text the fonts cannot display, goes through the
+  /// widget path instead, which starts fetching every image as soon as the
+  /// document is parsed. With [background] the PDF is laid out and written
+  /// on a separate isolate, which pays off for long documents. A [template]
+  /// also needs the widget path.
+  Future<Uint8List> convertText(String html,
+      {PdfPageFormat pageFormat = PdfPageFormat.a4,
+      int maxPages = 20,
+      bool background = false,
+      HtmlPageTemplate? template,
+      List<Font>? fontFallback,
+      Font? defaultFont}) async {
+    final metrics = ConversionMetrics.instance..bytesIn += html.length;
+    final config = _config(fontFallback, defaultFont);
+    final blocks = template == null
+        ? await metrics.time(
+            'text_blocks',
+            () => TextBlocksHTMLDecoder(grayscale: config.grayscale)
+                .convert(html))
+        : null;
+    if (blocks != null) {
+      final writer = PdfTextWriter(
+          pageFormat: pageFormat,
+          font: config.defaultFont,
+          hyphenator: config.hyphenator,
+          maxPages: maxPages);
+      final bytes = await metrics.time(
+          'text_write',
+          () => background
+              ? writer.writeInBackground(blocks)
+              : writer.write(blocks));
+      if (bytes != null) {
+        metrics.bytesOut += bytes.length;
+        return bytes;
+      }
+    }
+    final widgetDecoder = WidgetsHTMLDecoder(
+        config.copyWith(imageCache: config.imageCache ?? HtmlImageCache()));
+    final layout = await (template ?? const HtmlPageTemplate())
+        .resolve(widgetDecoder, pageFormat);
+    final widgets = await metrics.time('convert',
+        () => widgetDecoder.convertBlocks(html, prefetchImages: true).toList());
+    final document = Document();
+    document.addPage(layout.build(widgets, maxPages: maxPages));
+    final bytes = await metrics.time('save', document.save);
+    metrics.bytesOut += bytes.length;
+    return bytes;
+  }
+
+  /// Converts [html] with [convertText] and writes the PDF to [sink], which
+  /// is left open.
+  ///
+  /// Nothing is streamed: the pdf package lays out and serializes a
+  /// document as a whole, so the bytes are added to [sink] in one piece
+  /// once the whole PDF is done.
+  Future<void> render(String html, StreamSink<List<int>> sink,
+      {PdfPageFormat pageFormat = PdfPageFormat.a4,
+      int maxPages = 20,
+      bool background = false,
+      HtmlPageTemplate? template,
+      List<Font>? fontFallback,
+      Font? defaultFont}) async {
+    sink.add(await convertText(html,
+        pageFormat: pageFormat,
+        maxPages: maxPages,
+        background: background,
+        template: template,
+        fontFallback: fontFallback,
+        defaultFont: defaultFont));
+  }
+
+  /// Converts a batch of documents that share fonts and images.
+  ///
+  /// When [combine] is set every input is rendered into a single PDF, so each
+  /// font and image is embedded once for the whole batch. Otherwise one PDF
+  /// is returned per input: images are still fetched and decoded once, but
+  /// every PDF embeds its own copy. The [template] is converted once for the
+  /// whole batch.
+  Future<List<Uint8List>> convertBatch(List<String> htmls,
+      {bool combine = false,
+      PdfPageFormat pageFormat = PdfPageFormat.a4,
+      int maxPages = 20,
+      HtmlPageTemplate? template,
+      List<Font>? fontFallback,
+      Font? defaultFont}) async {
+    final metrics = ConversionMetrics.instance;
+    final config = _config(fontFallback, defaultFont);
+    final widgetDecoder = WidgetsHTMLDecoder(
+        config.copyWith(imageCache: config.imageCache ?? HtmlImageCache()));
+    final layout = await (template ?? const HtmlPageTemplate())
+        .resolve(widgetDecoder, pageFormat);
+    final result = <Uint8List>[];
+    var document = Document();
+    for (final html in htmls) {
+      metrics.bytesIn += html.length;
+      final widgets =
+          await metrics.time('convert', () => widgetDecoder.convert(html));
+      document.addPage(layout.build(widgets, maxPages: maxPages));
+      if (!combine) {
+        result.add(await metrics.time('save', document.save));
+        document = Document();
+      }
+    }
+    if (combine) {
+      result.add(await metrics.time('save', document.save));
+    }
+    metrics.bytesOut += result.fold(0, (sum, bytes) => sum + bytes.length);
+    return result;
   }
 }
 
 abstract class HtmlCodec {
+  const HtmlCodec();
+
   Future<List<Widget>> convert(String html,
       {List<Font>? fontFallback, Font? defaultFont});
 }
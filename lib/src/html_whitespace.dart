@@ -0,0 +1,87 @@
+import 'dart:typed_data';
+
+/// White space handling of CSS `white-space: normal`, and of `pre` for
+/// preformatted text.
+///
+/// Entities such as `&nbsp;` are already decoded by the html parser, and a
+/// decoded non-breaking space is kept as content.
+class HtmlWhitespace {
+  HtmlWhitespace._();
+
+  /// Output of [collapse], reused across calls; conversion never yields
+  /// while it is in use.
+  static var _buffer = Uint16List(1024);
+
+  static bool isCollapsibleSpace(int c) {
+    return c == 0x20 || c == 0x09 || c == 0x0a || c == 0x0c || c == 0x0d;
+  }
+
+  /// Collapses every run of spaces, tabs and line breaks in [text] to one
+  /// space. A leading run is dropped when [afterSpace], that is when the
+  /// text starts a block or follows a space.
+  ///
+  /// Text that is already collapsed is returned as is, without copying.
+  static String collapse(String text, {bool afterSpace = false}) {
+    if (!_needsCollapse(text, afterSpace)) {
+      return text;
+    }
+    if (_buffer.length < text.length) {
+      _buffer = Uint16List(text.length * 2);
+    }
+    final buffer = _buffer;
+    var length = 0;
+    var space = afterSpace;
+    for (var i = 0; i < text.length; i++) {
+      final c = text.codeUnitAt(i);
+      if (isCollapsibleSpace(c)) {
+        if (!space) {
+          buffer[length++] = 0x20;
+          space = true;
+        }
+      } else {
+        buffer[length++] = c;
+        space = false;
+      }
+    }
+    return String.fromCharCodes(buffer, 0, length);
+  }
+
+  /// Lines of preformatted [text], with its white space kept and tabs
+  /// expanded to the next multiple of [tabSize] columns.
+  static List<String> preformatted(String text, {int tabSize = 8}) {
+    final lines = <String>[];
+    final line = StringBuffer();
+    for (var i = 0; i < text.length; i++) {
+      final c = text.codeUnitAt(i);
+      if (c == 0x0a) {
+        lines.add(line.toString());
+        line.clear();
+      } else if (c == 0x09) {
+        line.write(' ' * (tabSize - line.length % tabSize));
+      } else if (c != 0x0d) {
+        line.writeCharCode(c);
+      }
+    }
+    // A final line break does not start another line.
+    if (line.isNotEmpty) {
+      lines.add(line.toString());
+    }
+    return lines;
+  }
+
+  static bool _needsCollapse(String text, bool afterSpace) {
+    var space = afterSpace;
+    for (var i = 0; i < text.length; i++) {
+      final c = text.codeUnitAt(i);
+      if (isCollapsibleSpace(c)) {
+        if (space || c != 0x20) {
+          return true;
+        }
+        space = true;
+      } else {
+        space = false;
+      }
+    }
+    return false;
+  }
+}
@@ -0,0 +1,692 @@
+import 'dart:collection';
+import 'dart:math' as math;
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart' show compute;
+
+import '../htmltopdfwidgets.dart';
+import 'conversion_metrics.dart';
+import 'html_hyphenator.dart';
+import 'html_whitespace.dart';
+import 'html_to_text_blocks.dart';
+
+/// Lays out [HtmlTextBlock]s and paints them straight onto PDF pages.
+///
+/// No widgets are built: words are measured with the page fonts, broken
+/// into lines greedily and drawn with the page graphics, filling one page
+/// after the other. Preformatted blocks are set in [fontMono] on a fixed
+/// grid instead, without measuring anything.
+class PdfTextWriter {
+  PdfTextWriter({
+    this.pageFormat = PdfPageFormat.a4,
+    Font? font,
+    Font? fontBold,
+    Font? fontItalic,
+    Font? fontBoldItalic,
+    Font? fontMono,
+    this.hyphenator,
+    this.maxPages = 20,
+  })  : fontMono = fontMono ?? Font.courier(),
+        font = font ?? Font.helvetica(),
+        fontBold = fontBold ?? font ?? Font.helveticaBold(),
+        fontItalic = fontItalic ?? font ?? Font.helveticaOblique(),
+        fontBoldItalic =
+            fontBoldItalic ?? font ?? Font.helveticaBoldOblique();
+
+  static const defaultFontSize = 12.0;
+
+  final PdfPageFormat pageFormat;
+  final Font font;
+  final Font fontBold;
+  final Font fontItalic;
+  final Font fontBoldItalic;
+
+  /// A monospace font, for preformatted text.
+  final Font fontMono;
+
+  /// Breaks words that overflow a line at their hyphenation points.
+  final HtmlHyphenator? hyphenator;
+
+  /// Like [MultiPage.maxPages], writing more pages throws a
+  /// [TooManyPagesException].
+  final int maxPages;
+
+  /// Returns null when a character is missing from the fonts, so that the
+  /// caller can fall back to widgets and their font fallback.
+  Future<Uint8List?> write(List<HtmlTextBlock> blocks) async {
+    final document = PdfDocument();
+    final page = _PageWriter(this, document);
+    try {
+      for (final block in blocks) {
+        page.writeBlock(block);
+      }
+    } on _MissingGlyph {
+      return null;
+    }
+    return await document.save();
+  }
+
+  /// Like [write], but lays out and serializes the document on a background
+  /// isolate, so the calling isolate stays free while the PDF is written.
+  ///
+  /// Every call runs on a fresh isolate: the blocks and the font bytes are
+  /// copied over each time and the fonts are built again there, and
+  /// [TextLayoutCache] starts out empty, so repeated text is measured again.
+  /// This pays off for long documents written from a UI isolate; servers
+  /// converting many similar documents are better off with [write].
+  Future<Uint8List?> writeInBackground(List<HtmlTextBlock> blocks) {
+    return compute(_write, _WriteJob(this, blocks));
+  }
+
+  static Future<Uint8List?> _write(_WriteJob job) {
+    // A font given for several styles is built once, to be embedded once.
+    final built = <Object, Font>{};
+    final fonts = [
+      for (final font in job.fonts) built.putIfAbsent(font.key, () => font.font)
+    ];
+    return PdfTextWriter(
+      pageFormat: job.pageFormat,
+      font: fonts[0],
+      fontBold: fonts[1],
+      fontItalic: fonts[2],
+      fontBoldItalic: fonts[3],
+      fontMono: fonts[4],
+      hyphenator: job.hyphenator,
+      maxPages: job.maxPages,
+    ).write(job.blocks);
+  }
+}
+
+/// Line breaks of recently written blocks, shared by every [PdfTextWriter]
+/// in the isolate.
+///
+/// Entries are keyed by the block text, the fonts and styles of its runs and
+/// the available width, so repeated boilerplate is measured once. The least
+/// recently used entries are dropped beyond [maxEntries].
+class TextLayoutCache {
+  TextLayoutCache._();
+
+  static final instance = TextLayoutCache._();
+
+  int maxEntries = 2000;
+  int hits = 0;
+  int misses = 0;
+
+  final _layouts = LinkedHashMap<String, List<_Line>>();
+
+  double get hitRate {
+    final total = hits + misses;
+    return total == 0 ? 0 : hits / total;
+  }
+
+  int get length => _layouts.length;
+
+  List<_Line>? _get(String key) {
+    final lines = _layouts.remove(key);
+    ConversionMetrics.instance.cache('layout', hit: lines != null);
+    if (lines == null) {
+      misses++;
+      return null;
+    }
+    hits++;
+    _layouts[key] = lines;
+    return lines;
+  }
+
+  void _put(String key, List<_Line> lines) {
+    _layouts[key] = lines;
+    trim(maxEntries);
+  }
+
+  /// Drops least recently used layouts until at most [entries] remain.
+  void trim(int entries) {
+    while (_layouts.length > entries) {
+      _layouts.remove(_layouts.keys.first);
+    }
+  }
+
+  void clear() {
+    _layouts.clear();
+    hits = 0;
+    misses = 0;
+  }
+}
+
+/// What [PdfTextWriter._write] needs, without the writer's fonts: a font
+/// keeps the document it was last used in, which would be copied along.
+class _WriteJob {
+  _WriteJob(PdfTextWriter writer, this.blocks)
+      : pageFormat = writer.pageFormat,
+        fonts = [
+          writer.font,
+          writer.fontBold,
+          writer.fontItalic,
+          writer.fontBoldItalic,
+          writer.fontMono,
+        ].map(_FontData.new).toList(),
+        hyphenator = writer.hyphenator,
+        maxPages = writer.maxPages;
+
+  final PdfPageFormat pageFormat;
+  final List<_FontData> fonts;
+  final HtmlHyphenator? hyphenator;
+  final int maxPages;
+  final List<HtmlTextBlock> blocks;
+}
+
+/// A built-in font by name, or a TrueType font by its bytes.
+class _FontData {
+  _FontData(Font font)
+      : type1 = font.font,
+        data = font is TtfFont ? font.data : null;
+
+  final Type1Fonts? type1;
+  final ByteData? data;
+
+  Object get key => data ?? type1!;
+
+  Font get font => data != null ? TtfFont(data!) : Font.type1(type1!);
+}
+
+/// Which of the writer's fonts a fragment is set in.
+enum _FontRole { regular, bold, italic, boldItalic }
+
+/// A measured piece of a word. Fragments outlive their writer in
+/// [TextLayoutCache], so they hold a font role and metrics, never a [Font]
+/// or [TextStyle]: a font keeps the document it was last used in.
+class _Fragment {
+  _Fragment(this.text, this.role, this.size, this.color, this.decoration,
+      this.width, this.ascent, this.descent, this.spaceWidth);
+
+  final String text;
+  final _FontRole role;
+  final double size;
+  final PdfColor? color;
+  final TextDecoration? decoration;
+  final double width;
+  final double ascent;
+  final double descent;
+  final double spaceWidth;
+}
+
+class _Word {
+  _Word() : lineBreak = false;
+
+  _Word.lineBreak() : lineBreak = true;
+
+  final bool lineBreak;
+  final fragments = <_Fragment>[];
+  double width = 0;
+
+  void add(_Fragment fragment) {
+    fragments.add(fragment);
+    width += fragment.width;
+  }
+
+  double get spaceWidth => fragments.last.spaceWidth;
+}
+
+class _Line {
+  _Line(this.words, this.ascent, this.height);
+
+  final List<_Word> words;
+  final double ascent;
+  final double height;
+}
+
+class _MissingGlyph implements Exception {}
+
+class _PageWriter {
+  _PageWriter(this.writer, this.document)
+      : context = Context(document: document);
+
+  static const _listIndent = 22.0;
+  static const _numberIndent = 20.0;
+  static const _quoteIndent = 20.0;
+
+  static final _layoutIds = Expando<int>();
+  static var _nextLayoutId = 0;
+
+  final PdfTextWriter writer;
+  final PdfDocument document;
+  final Context context;
+
+  PdfGraphics? _graphics;
+  double _y = 0;
+  int _pages = 0;
+
+  // Graphics state of the current page, so that it is only set on change.
+  int? _fillColor;
+  int? _strokeColor;
+  double? _lineWidth;
+
+  /// Built-in fonts are keyed by name, since every writer creates its own
+  /// rather than share instances that keep their last document alive.
+  /// Other fonts and the hyphenator are keyed by identity.
+  late final String _fontKey = [
+    writer.font,
+    writer.fontBold,
+    writer.fontItalic,
+    writer.fontBoldItalic,
+    if (writer.hyphenator != null) writer.hyphenator!,
+  ].map(_layoutId).join(',');
+
+  static String _layoutId(Object object) {
+    if (object is Font && object.font != null) {
+      return object.font!.name;
+    }
+    return '${_layoutIds[object] ??= _nextLayoutId++}';
+  }
+
+  PdfPageFormat get _format => writer.pageFormat;
+
+  PdfGraphics get _page => _graphics ??= _addPage();
+
+  PdfGraphics _addPage() {
+    if (++_pages > writer.maxPages) {
+      throw TooManyPagesException(
+          'The text blocks filled more than ${writer.maxPages} pages.');
+    }
+    return PdfPage(document, pageFormat: _format).getGraphics();
+  }
+
+  void _newPage() {
+    _graphics = null;
+    _y = 0;
+    _fillColor = null;
+    _strokeColor = null;
+    _lineWidth = null;
+  }
+
+  void _setFillColor(PdfColor color) {
+    final value = color.toInt();
+    if (value != _fillColor) {
+      _page.setFillColor(color);
+      _fillColor = value;
+    }
+  }
+
+  void _setStroke(PdfColor color, double width) {
+    final value = color.toInt();
+    if (value != _strokeColor) {
+      _page.setStrokeColor(color);
+      _strokeColor = value;
+    }
+    if (width != _lineWidth) {
+      _page.setLineWidth(width);
+      _lineWidth = width;
+    }
+  }
+
+  static _FontRole _roleFor(TextStyle style) {
+    final bold = style.fontWeight == FontWeight.bold;
+    final italic = style.fontStyle == FontStyle.italic;
+    return bold
+        ? (italic ? _FontRole.boldItalic : _FontRole.bold)
+        : (italic ? _FontRole.italic : _FontRole.regular);
+  }
+
+  Font _font(_FontRole role) {
+    switch (role) {
+      case _FontRole.bold:
+        return writer.fontBold;
+      case _FontRole.italic:
+        return writer.fontItalic;
+      case _FontRole.boldItalic:
+        return writer.fontBoldItalic;
+      default:
+        return writer.font;
+    }
+  }
+
+  void writeBlock(HtmlTextBlock block) {
+    if (block.type == HtmlTextBlockType.code) {
+      _writeCode(block);
+      return;
+    }
+    final indent = _indent(block.type);
+    final lines = _layout(block, _format.availableWidth - indent);
+    for (var i = 0; i < lines.length; i++) {
+      final line = lines[i];
+      if (_y > 0 && _y + line.height > _format.availableHeight) {
+        _newPage();
+      }
+      final top = _format.height - _format.marginTop - _y;
+      if (i == 0) {
+        _paintMarker(block, top, line.height);
+      }
+      if (block.type == HtmlTextBlockType.quote) {
+        _setStroke(PdfColors.black, 1);
+        _page
+          ..drawLine(_format.marginLeft + _quoteIndent / 2, top,
+              _format.marginLeft + _quoteIndent / 2, top - line.height)
+          ..strokePath();
+      }
+      _paintLine(line, _format.marginLeft + indent, top - line.ascent);
+      _y += line.height;
+    }
+  }
+
+  /// Every character of a monospace font advances by the width of a space,
+  /// so lines are cut every `columns` characters and placed one line height
+  /// apart, with no measuring, line breaking or layout cache.
+  void _writeCode(HtmlTextBlock block) {
+    final run = block.runs.single;
+    final font = writer.fontMono.getFont(context);
+    final size = run.style.fontSize ?? PdfTextWriter.defaultFontSize;
+    final color = run.style.color ?? PdfColors.black;
+    final ascent = font.ascent * size;
+    final height = (font.ascent - font.descent) * size;
+    final advance = font.stringMetrics(' ').advanceWidth * size;
+    final columns = math.max(1, _format.availableWidth ~/ advance);
+    for (final text in HtmlWhitespace.preformatted(run.text)) {
+      for (final rune in text.runes) {
+        if (!font.isRuneSupported(rune)) {
+          throw _MissingGlyph();
+        }
+      }
+      var start = 0;
+      do {
+        final end = math.min(start + columns, text.length);
+        if (_y > 0 && _y + height > _format.availableHeight) {
+          _newPage();
+        }
+        final line = text.substring(start, end).trimRight();
+        if (line.isNotEmpty) {
+          _setFillColor(color);
+          _page.drawString(font, size, line, _format.marginLeft,
+              _format.height - _format.marginTop - _y - ascent);
+        }
+        _y += height;
+        start = end;
+      } while (start < text.length);
+    }
+  }
+
+  List<_Line> _layout(HtmlTextBlock block, double maxWidth) {
+    final cache = TextLayoutCache.instance;
+    final key = _layoutKey(block, maxWidth);
+    final cached = cache._get(key);
+    if (cached != null) {
+      return cached;
+    }
+    final lines = _breakLines(_words(block), maxWidth, block);
+    cache._put(key, lines);
+    return lines;
+  }
+
+  String _layoutKey(HtmlTextBlock block, double maxWidth) {
+    final key = StringBuffer()
+      ..write(_fontKey)
+      ..write('|')
+      ..write(maxWidth);
+    for (final run in block.runs) {
+      final style = run.style;
+      key
+        ..write('|')
+        ..write(style.fontWeight == FontWeight.bold ? 'b' : '')
+        ..write(style.fontStyle == FontStyle.italic ? 'i' : '')
+        ..write(',')
+        ..write(style.fontSize)
+        ..write(',')
+        ..write(style.color?.toInt())
+        ..write(',')
+        ..write(style.decoration?.hashCode)
+        ..write(':')
+        ..write(run.text);
+    }
+    return key.toString();
+  }
+
+  double _indent(HtmlTextBlockType type) {
+    switch (type) {
+      case HtmlTextBlockType.bulletedList:
+        return _listIndent;
+      case HtmlTextBlockType.numberList:
+        return _numberIndent;
+      case HtmlTextBlockType.quote:
+        return _quoteIndent;
+      default:
+        return 0;
+    }
+  }
+
+  void _paintMarker(HtmlTextBlock block, double top, double height) {
+    final x = _format.marginLeft;
+    if (block.type == HtmlTextBlockType.bulletedList) {
+      _setFillColor(PdfColors.black);
+      _page
+        ..drawEllipse(x + (_listIndent - 5) / 2, top - height / 2, 2.5, 2.5)
+        ..fillPath();
+    } else if (block.type == HtmlTextBlockType.numberList) {
+      final font = writer.font.getFont(context);
+      _setFillColor(PdfColors.black);
+      _page.drawString(font, PdfTextWriter.defaultFontSize, '${block.index}.',
+          x, top - font.ascent * PdfTextWriter.defaultFontSize);
+    }
+  }
+
+  List<_Word> _words(HtmlTextBlock block) {
+    final words = <_Word>[];
+    var word = _Word();
+    for (final run in block.runs) {
+      final style = run.style;
+      final role = _roleFor(style);
+      final size = style.fontSize ?? PdfTextWriter.defaultFontSize;
+      final text = run.text;
+      var start = 0;
+      for (var i = 0; i <= text.length; i++) {
+        final c = i < text.length ? text.codeUnitAt(i) : -1;
+        final lineBreak = c == 0x2028;
+        if (c != -1 &&
+            !lineBreak &&
+            !HtmlWhitespace.isCollapsibleSpace(c)) {
+          continue;
+        }
+        if (i > start) {
+          word.add(_fragment(text.substring(start, i), role, size,
+              style.color, style.decoration));
+        }
+        start = i + 1;
+        if (c == -1) {
+          break;
+        }
+        if (word.fragments.isNotEmpty) {
+          words.add(word);
+          word = _Word();
+        }
+        if (lineBreak) {
+          words.add(_Word.lineBreak());
+        }
+      }
+    }
+    if (word.fragments.isNotEmpty) {
+      words.add(word);
+    }
+    return words;
+  }
+
+  _Fragment _fragment(String text, _FontRole role, double size,
+      PdfColor? color, TextDecoration? decoration) {
+    final pdfFont = _font(role).getFont(context);
+    for (final rune in text.runes) {
+      if (!pdfFont.isRuneSupported(rune)) {
+        throw _MissingGlyph();
+      }
+    }
+    return _Fragment(
+      text,
+      role,
+      size,
+      color,
+      decoration,
+      pdfFont.stringMetrics(text).advanceWidth * size,
+      pdfFont.ascent * size,
+      pdfFont.descent * size,
+      pdfFont.stringMetrics(' ').advanceWidth * size,
+    );
+  }
+
+  List<_Line> _breakLines(
+      List<_Word> words, double maxWidth, HtmlTextBlock block) {
+    final lines = <_Line>[];
+    var line = <_Word>[];
+    var width = 0.0;
+    for (var word in words) {
+      if (word.lineBreak) {
+        lines.add(_measureLine(line, block));
+        line = <_Word>[];
+        width = 0;
+        continue;
+      }
+      while (true) {
+        final space = line.isEmpty ? 0.0 : line.last.spaceWidth;
+        if (width + space + word.width <= maxWidth) {
+          width += space + word.width;
+          line.add(word);
+          break;
+        }
+        final parts = _hyphenate(word, maxWidth - width - space);
+        if (parts != null) {
+          line.add(parts[0]);
+          lines.add(_measureLine(line, block));
+          line = <_Word>[];
+          width = 0;
+          word = parts[1];
+        } else if (line.isEmpty) {
+          // Too long for a line of its own, let it overflow.
+          width = word.width;
+          line.add(word);
+          break;
+        } else {
+          lines.add(_measureLine(line, block));
+          line = <_Word>[];
+          width = 0;
+        }
+      }
+    }
+    if (line.isNotEmpty) {
+      lines.add(_measureLine(line, block));
+    }
+    return lines;
+  }
+
+  /// Splits [word] at its last hyphenation point that leaves a first part,
+  /// hyphen included, no wider than [available].
+  List<_Word>? _hyphenate(_Word word, double available) {
+    final hyphenator = writer.hyphenator;
+    if (hyphenator == null || word.fragments.length != 1) {
+      return null;
+    }
+    final fragment = word.fragments.single;
+    final points = hyphenator.hyphenate(fragment.text);
+    for (var i = points.length - 1; i >= 0; i--) {
+      // A break at either end would leave the whole word to break again.
+      if (points[i] <= 0 || points[i] >= fragment.text.length) {
+        continue;
+      }
+      final head = _fragment('${fragment.text.substring(0, points[i])}-',
+          fragment.role, fragment.size, fragment.color, fragment.decoration);
+      if (head.width <= available) {
+        final tail = _fragment(fragment.text.substring(points[i]),
+            fragment.role, fragment.size, fragment.color, fragment.decoration);
+        return [_Word()..add(head), _Word()..add(tail)];
+      }
+    }
+    return null;
+  }
+
+  _Line _measureLine(List<_Word> words, HtmlTextBlock block) {
+    if (words.isEmpty) {
+      final style = block.runs.first.style;
+      final font = _font(_roleFor(style)).getFont(context);
+      final size = style.fontSize ?? PdfTextWriter.defaultFontSize;
+      return _Line(words, 0, (font.ascent - font.descent) * size);
+    }
+    var ascent = 0.0;
+    var height = 0.0;
+    for (final word in words) {
+      for (final fragment in word.fragments) {
+        if (fragment.ascent > ascent) {
+          ascent = fragment.ascent;
+        }
+        final h = fragment.ascent - fragment.descent;
+        if (h > height) {
+          height = h;
+        }
+      }
+    }
+    return _Line(words, ascent, height);
+  }
+
+  /// Paints [line], drawing consecutive fragments that share a style as a
+  /// single string, spaces between words included, so that a line holds one
+  /// text object per style change rather than one per word.
+  void _paintLine(_Line line, double x, double baseline) {
+    final text = StringBuffer();
+    _Fragment? run;
+    var runX = x;
+    var runWidth = 0.0;
+    for (final word in line.words) {
+      for (var i = 0; i < word.fragments.length; i++) {
+        final fragment = word.fragments[i];
+        if (run != null && !_sameStyle(run, fragment)) {
+          _paintRun(run, text.toString(), runX, runWidth, baseline);
+          run = null;
+        }
+        if (run == null) {
+          text.clear();
+          run = fragment;
+          runX = x;
+          runWidth = 0;
+        } else if (i == 0) {
+          text.write(' ');
+          runWidth += run.spaceWidth;
+        }
+        text.write(fragment.text);
+        runWidth += fragment.width;
+        x += fragment.width;
+      }
+      x += word.spaceWidth;
+    }
+    if (run != null) {
+      _paintRun(run, text.toString(), runX, runWidth, baseline);
+    }
+  }
+
+  bool _sameStyle(_Fragment a, _Fragment b) {
+    return identical(_font(a.role), _font(b.role)) &&
+        a.size == b.size &&
+        a.color?.toInt() == b.color?.toInt() &&
+        a.decoration == b.decoration;
+  }
+
+  void _paintRun(_Fragment fragment, String text, double x, double width,
+      double baseline) {
+    final color = fragment.color ?? PdfColors.black;
+    _setFillColor(color);
+    _page.drawString(_font(fragment.role).getFont(context), fragment.size,
+        text, x, baseline);
+
+    final decoration = fragment.decoration;
+    if (decoration == null) {
+      return;
+    }
+    final lines = <double>[
+      if (decoration.contains(TextDecoration.underline))
+        baseline + fragment.descent / 2,
+      if (decoration.contains(TextDecoration.lineThrough))
+        baseline + fragment.ascent / 3,
+      if (decoration.contains(TextDecoration.overline))
+        baseline + fragment.ascent,
+    ];
+    if (lines.isEmpty) {
+      return;
+    }
+    _setStroke(color, fragment.size / 20);
+    for (final y in lines) {
+      _page.drawLine(x, y, x + width, y);
+    }
+    _page.strokePath();
+  }
+}
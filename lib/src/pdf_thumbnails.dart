@@ -0,0 +1,130 @@
+import 'dart:async';
+import 'dart:collection';
+import 'dart:math' as math;
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart' show compute;
+import 'package:image/image.dart' as img;
+import 'package:printing/printing.dart';
+
+import 'conversion_metrics.dart';
+
+enum PdfThumbnailFormat { png, jpeg }
+
+class PdfThumbnail {
+  const PdfThumbnail(this.page, this.bytes);
+
+  /// Zero-based page index.
+  final int page;
+
+  /// The encoded image.
+  final Uint8List bytes;
+}
+
+/// Rasterizes pages of generated PDFs into thumbnails.
+///
+/// Pages are shared out between [concurrency] rasterizer jobs and every
+/// thumbnail is emitted as soon as it is encoded, so the first ones show up
+/// long before the range is done. Thumbnails are kept by document content,
+/// page, resolution and format; the least recently used are dropped beyond
+/// [maxEntries].
+class PdfThumbnails {
+  PdfThumbnails._();
+
+  static final instance = PdfThumbnails._();
+
+  int concurrency = 4;
+  int maxEntries = 512;
+
+  final _thumbnails = LinkedHashMap<String, Uint8List>();
+
+  int get length => _thumbnails.length;
+
+  /// Renders the zero-based [pages] of [document] at [dpi], in completion
+  /// order.
+  Stream<PdfThumbnail> render(Uint8List document, Iterable<int> pages,
+      {double dpi = 36,
+      PdfThumbnailFormat format = PdfThumbnailFormat.png}) {
+    final controller = StreamController<PdfThumbnail>();
+    final key = '${_hash(document)}:${document.length}:$dpi:${format.name}';
+    final missing = <int>[];
+    for (final page in pages) {
+      final cached = _thumbnails.remove('$key:$page');
+      ConversionMetrics.instance.cache('thumbnail', hit: cached != null);
+      if (cached == null) {
+        missing.add(page);
+      } else {
+        _thumbnails['$key:$page'] = cached;
+        controller.add(PdfThumbnail(page, cached));
+      }
+    }
+
+    // Pages are dealt round robin, so that every job starts near the top.
+    final jobs = <Future<void>>[];
+    final count = math.min(concurrency, missing.length);
+    for (var j = 0; j < count; j++) {
+      final share = [
+        for (var i = j; i < missing.length; i += count) missing[i]
+      ];
+      jobs.add(_raster(document, share, dpi, format, key, controller));
+    }
+    Future.wait(jobs).then((_) {}, onError: (Object e, StackTrace s) {
+      controller.addError(e, s);
+    }).whenComplete(controller.close);
+    return controller.stream;
+  }
+
+  Future<void> _raster(
+      Uint8List document,
+      List<int> pages,
+      double dpi,
+      PdfThumbnailFormat format,
+      String key,
+      StreamController<PdfThumbnail> controller) async {
+    var index = 0;
+    await for (final raster
+        in Printing.raster(document, pages: pages, dpi: dpi)) {
+      final page = pages[index++];
+      final bytes = format == PdfThumbnailFormat.png
+          ? await raster.toPng()
+          : await compute(_encodeJpeg,
+              _JpegJob(raster.pixels, raster.width, raster.height));
+      _thumbnails['$key:$page'] = bytes;
+      while (_thumbnails.length > maxEntries) {
+        _thumbnails.remove(_thumbnails.keys.first);
+      }
+      controller.add(PdfThumbnail(page, bytes));
+    }
+  }
+
+  void clear() {
+    _thumbnails.clear();
+  }
+
+  static int _hash(Uint8List bytes) {
+    // FNV-1a, kept to 32 bits so that it also runs on the web.
+    var hash = 0x811c9dc5;
+    for (final byte in bytes) {
+      hash = ((hash ^ byte) * 0x01000193) & 0xffffffff;
+    }
+    return hash;
+  }
+}
+
+class _JpegJob {
+  _JpegJob(this.pixels, this.width, this.height);
+
+  final Uint8List pixels;
+  final int width;
+  final int height;
+}
+
+Uint8List _encodeJpeg(_JpegJob job) {
+  final image = img.Image.fromBytes(
+      width: job.width,
+      height: job.height,
+      bytes: job.pixels.buffer,
+      bytesOffset: job.pixels.offsetInBytes,
+      numChannels: 4);
+  return img.encodeJpg(image, quality: 85);
+}
@@ -0,0 +1,49 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart';
+
+Duration _seconds(double seconds) =>
+    Duration(microseconds: (seconds * Duration.microsecondsPerSecond).floor());
+
+void main() {
+  final bounds = LatencyHistogram.bounds;
+
+  test('records values at and below the lowest bound', () {
+    final histogram = LatencyHistogram()
+      ..record(Duration.zero)
+      ..record(_seconds(bounds.first));
+    expect(histogram.count, 2);
+    expect(histogram.percentile(1), bounds.first);
+  });
+
+  test('records values at the highest bound', () {
+    final histogram = LatencyHistogram()..record(_seconds(bounds.last));
+    expect(histogram.percentile(1), bounds.last);
+  });
+
+  test('records values past the highest bound as overflow', () {
+    final histogram = LatencyHistogram()
+      ..record(_seconds(bounds.last + 1))
+      ..record(const Duration(days: 1));
+    expect(histogram.count, 2);
+    expect(histogram.percentile(0.5), double.infinity);
+  });
+
+  test('finds the bucket of values between bounds', () {
+    final histogram = LatencyHistogram();
+    for (var i = 1; i < bounds.length; i++) {
+      histogram.record(_seconds((bounds[i - 1] + bounds[i]) / 2));
+    }
+    expect(histogram.count, bounds.length - 1);
+    expect(histogram.percentile(1), bounds.last);
+    expect(histogram.percentile(0), bounds[1]);
+  });
+
+  test('times stages that outlast the histogram', () async {
+    final metrics = ConversionMetrics.instance..reset();
+    final result = await metrics.time('save', () async => 1);
+    metrics.record('save', const Duration(hours: 1));
+    expect(result, 1);
+    expect(metrics.toPrometheus(),
+        contains('htmltopdf_stage_seconds_count{stage="save"} 2'));
+  });
+}
@@ -0,0 +1,184 @@
+import 'dart:async';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart';
+
+/// Lets every pending microtask run, so that granted jobs start.
+Future<void> _settle() => Future<void>.delayed(Duration.zero);
+
+void main() {
+  test('runs at most concurrency jobs at once', () async {
+    final scheduler = ConversionScheduler(concurrency: 2);
+    final gates = [for (var i = 0; i < 3; i++) Completer<void>()];
+    final started = <int>[];
+    final results = [
+      for (var i = 0; i < 3; i++)
+        scheduler.schedule((job) async {
+          started.add(i);
+          await gates[i].future;
+          return i;
+        })
+    ];
+    await _settle();
+    expect(started, [0, 1]);
+    expect(scheduler.running, 2);
+    expect(scheduler.queued(ConversionLane.batch), 1);
+
+    gates[0].complete();
+    await _settle();
+    expect(started, [0, 1, 2]);
+
+    gates[1].complete();
+    gates[2].complete();
+    expect(await Future.wait(results), [0, 1, 2]);
+    expect(scheduler.completed, 3);
+    expect(scheduler.running, 0);
+  });
+
+  test('starts queued interactive jobs before batch jobs', () async {
+    final scheduler = ConversionScheduler(concurrency: 1);
+    final gate = Completer<void>();
+    final order = <String>[];
+    final blocker = scheduler.schedule((job) => gate.future);
+    await _settle();
+    final batch = scheduler.schedule((job) async {
+      order.add('batch');
+    });
+    final interactive = scheduler.schedule((job) async {
+      order.add('interactive');
+    }, lane: ConversionLane.interactive);
+
+    gate.complete();
+    await Future.wait([blocker, batch, interactive]);
+    expect(order, ['interactive', 'batch']);
+  });
+
+  test('batch jobs give their slot up at a checkpoint', () async {
+    final scheduler = ConversionScheduler(concurrency: 1);
+    final gate = Completer<void>();
+    final order = <String>[];
+    final batch = scheduler.schedule((job) async {
+      order.add('batch start');
+      await gate.future;
+      await job.checkpoint();
+      order.add('batch end');
+    });
+    await _settle();
+    final interactive = scheduler.schedule((job) async {
+      order.add('interactive');
+    }, lane: ConversionLane.interactive);
+
+    gate.complete();
+    await Future.wait([batch, interactive]);
+    expect(order, ['batch start', 'interactive', 'batch end']);
+    expect(scheduler.preempted, 1);
+    expect(scheduler.completed, 2);
+    expect(scheduler.running, 0);
+  });
+
+  test('cancels a queued job right away', () async {
+    final scheduler = ConversionScheduler(concurrency: 1);
+    final gate = Completer<void>();
+    final blocker = scheduler.schedule((job) => gate.future);
+    final token = ConversionCancelToken();
+    var ran = false;
+    final cancelled = scheduler.schedule((job) async {
+      ran = true;
+    }, cancelToken: token);
+    final expectation = expectLater(
+        cancelled, throwsA(isA<ConversionCancelledException>()));
+    await _settle();
+    expect(scheduler.queued(ConversionLane.batch), 1);
+
+    token.cancel();
+    await expectation;
+    expect(scheduler.queued(ConversionLane.batch), 0);
+    expect(scheduler.queuedCost(ConversionLane.batch), 0);
+
+    gate.complete();
+    await blocker;
+    expect(ran, isFalse);
+    expect(scheduler.cancelled, 1);
+    expect(scheduler.failed, 0);
+    expect(scheduler.completed, 1);
+  });
+
+  test('cancels a running job at its next checkpoint', () async {
+    final scheduler = ConversionScheduler(concurrency: 1);
+    final gate = Completer<void>();
+    final token = ConversionCancelToken();
+    final result = scheduler.schedule((job) async {
+      await gate.future;
+      await job.checkpoint();
+      return 1;
+    }, cancelToken: token);
+    final expectation =
+        expectLater(result, throwsA(isA<ConversionCancelledException>()));
+    await _settle();
+
+    token.cancel();
+    gate.complete();
+    await expectation;
+    expect(scheduler.cancelled, 1);
+    expect(scheduler.failed, 0);
+    expect(scheduler.running, 0);
+  });
+
+  test('a preempted job cancelled in the queue frees no slot', () async {
+    final scheduler = ConversionScheduler(concurrency: 1);
+    final batchGate = Completer<void>();
+    final interactiveGate = Completer<void>();
+    final token = ConversionCancelToken();
+    final batch = scheduler.schedule((job) async {
+      await batchGate.future;
+      await job.checkpoint();
+    }, cancelToken: token);
+    final expectation =
+        expectLater(batch, throwsA(isA<ConversionCancelledException>()));
+    await _settle();
+    final interactive = scheduler.schedule((job) => interactiveGate.future,
+        lane: ConversionLane.interactive);
+
+    batchGate.complete();
+    await _settle();
+    expect(scheduler.preempted, 1);
+    expect(scheduler.queued(ConversionLane.batch), 1);
+
+    token.cancel();
+    await expectation;
+    expect(scheduler.running, 1);
+
+    interactiveGate.complete();
+    await interactive;
+    expect(scheduler.running, 0);
+    expect(scheduler.cancelled, 1);
+    expect(scheduler.completed, 1);
+  });
+
+  test('counts failures apart from cancellations', () async {
+    final scheduler = ConversionScheduler();
+    await expectLater(
+        scheduler.schedule<void>((job) async {
+          throw StateError('failed');
+        }),
+        throwsStateError);
+    expect(scheduler.failed, 1);
+    expect(scheduler.cancelled, 0);
+  });
+
+  test('rejects jobs beyond a full queue', () async {
+    final scheduler = ConversionScheduler(concurrency: 1, maxQueued: 1);
+    final gate = Completer<void>();
+    final blocker = scheduler.schedule((job) => gate.future);
+    final queued = scheduler.schedule((job) async {});
+    await _settle();
+
+    await expectLater(scheduler.schedule((job) async {}),
+        throwsA(isA<ConversionRejectedException>()));
+    expect(scheduler.rejected, 1);
+    expect(scheduler.failed, 0);
+
+    gate.complete();
+    await Future.wait([blocker, queued]);
+  });
+}
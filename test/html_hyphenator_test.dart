@@ -0,0 +1,54 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart';
+
+// The patterns of Liang's thesis that hyphenate "hyphenation".
+const _patterns = 'hy3ph he2n hena4 hen5at 1na n2at 1tio 2io o2n';
+
+void main() {
+  final hyphenator =
+      HtmlHyphenator.fromPatterns(_patterns, exceptions: 'ta-ble');
+
+  test('finds the odd points of the matching patterns', () {
+    expect(hyphenator.hyphenate('hyphenation'), [2, 6]);
+    expect(hyphenator.hyphenate('nation'), [2]);
+  });
+
+  test('ignores case', () {
+    expect(hyphenator.hyphenate('Hyphenation'), [2, 6]);
+  });
+
+  test('keeps leftMin and rightMin letters on each side', () {
+    expect(hyphenator.hyphenate('hen'), isEmpty);
+    final strict = HtmlHyphenator.fromPatterns(_patterns, leftMin: 3);
+    expect(strict.hyphenate('hyphenation'), [6]);
+  });
+
+  test('uses exceptions as given', () {
+    expect(hyphenator.hyphenate('table'), [2]);
+    expect(hyphenator.hyphenate('TABLE'), [2]);
+  });
+
+  test('keeps exceptions inside leftMin and rightMin', () {
+    final edges = HtmlHyphenator.fromPatterns('',
+        exceptions: '-word sh-ort-er-', leftMin: 1, rightMin: 1);
+    expect(edges.hyphenate('word'), isEmpty);
+    expect(edges.hyphenate('shorter'), [2, 5]);
+  });
+
+  test('ignores punctuation around the word', () {
+    expect(hyphenator.hyphenate('hyphenation,'), [2, 6]);
+    expect(hyphenator.hyphenate('(nation)'), [3]);
+    expect(hyphenator.hyphenate('"hen".'), isEmpty);
+  });
+
+  test('caches results per word', () {
+    final first = hyphenator.hyphenate('hyphenation');
+    expect(identical(hyphenator.hyphenate('hyphenation'), first), isTrue);
+    expect(() => first.add(1), throwsUnsupportedError);
+  });
+
+  test('parses the patterns of a language once', () {
+    final english = HtmlHyphenator.load('en-test', _patterns);
+    expect(identical(HtmlHyphenator.load('en-test', ''), english), isTrue);
+  });
+}
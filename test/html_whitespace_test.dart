@@ -0,0 +1,52 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/src/html_whitespace.dart';
+
+void main() {
+  group('collapse', () {
+    test('collapses runs of spaces, tabs and line breaks', () {
+      expect(HtmlWhitespace.collapse('a  b\t\tc\n\r\nd'), 'a b c d');
+    });
+
+    test('keeps a single leading and trailing space', () {
+      expect(HtmlWhitespace.collapse('  a  '), ' a ');
+    });
+
+    test('drops leading space after a space', () {
+      expect(HtmlWhitespace.collapse('  a  ', afterSpace: true), 'a ');
+      expect(HtmlWhitespace.collapse(' \n ', afterSpace: true), '');
+    });
+
+    test('keeps non-breaking spaces', () {
+      expect(HtmlWhitespace.collapse('a\u00a0\u00a0 b'), 'a\u00a0\u00a0 b');
+    });
+
+    test('returns collapsed text without copying', () {
+      const text = 'already collapsed';
+      expect(identical(HtmlWhitespace.collapse(text), text), isTrue);
+    });
+
+    test('handles text longer than its buffer', () {
+      final text = 'word   ' * 1000;
+      expect(HtmlWhitespace.collapse(text), 'word ' * 1000);
+    });
+  });
+
+  group('preformatted', () {
+    test('keeps spaces and splits lines', () {
+      expect(HtmlWhitespace.preformatted('a  b\n  c\n'), ['a  b', '  c']);
+    });
+
+    test('keeps empty lines', () {
+      expect(HtmlWhitespace.preformatted('a\n\nb'), ['a', '', 'b']);
+    });
+
+    test('expands tabs to the next tab stop', () {
+      expect(HtmlWhitespace.preformatted('\tx\nab\ty', tabSize: 4),
+          ['    x', 'ab  y']);
+    });
+
+    test('drops carriage returns', () {
+      expect(HtmlWhitespace.preformatted('a\r\nb'), ['a', 'b']);
+    });
+  });
+}
@@ -0,0 +1,87 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:htmltopdfwidgets/htmltopdfwidgets.dart';
+import 'package:htmltopdfwidgets/src/html_to_text_blocks.dart';
+import 'package:htmltopdfwidgets/src/pdf_text_writer.dart';
+
+Future<List<HtmlTextBlock>> _blocks(String html) async {
+  return (await TextBlocksHTMLDecoder().convert(html))!;
+}
+
+void main() {
+  group('TextBlocksHTMLDecoder', () {
+    test('returns null on unsupported elements', () async {
+      final decoder = TextBlocksHTMLDecoder();
+      expect(await decoder.convert('<p>a <img src="a.png"> b</p>'), isNull);
+      expect(await decoder.convert('<table><tr><td>a</td></tr></table>'),
+          isNull);
+      expect(await decoder.convert('<ul><p>not an item</p></ul>'), isNull);
+    });
+
+    test('numbers ordered list items', () async {
+      final blocks =
+          await _blocks('<ol><li>a</li><li>b</li></ol><ul><li>c</li></ul>');
+      expect(blocks.map((block) => block.type), [
+        HtmlTextBlockType.numberList,
+        HtmlTextBlockType.numberList,
+        HtmlTextBlockType.bulletedList,
+      ]);
+      expect(blocks.map((block) => block.index), [1, 2, null]);
+    });
+
+    test('turns <br> into a line break run', () async {
+      final blocks = await _blocks('<p>a<br>b</p>');
+      expect(blocks.single.runs.map((run) => run.text),
+          ['a', HtmlTextRun.lineBreak, 'b']);
+    });
+  });
+
+  group('PdfTextWriter', () {
+    test('returns null on a missing glyph', () async {
+      final writer = PdfTextWriter();
+      expect(await writer.write(await _blocks('<p>漢字</p>')), isNull);
+      expect(await writer.write(await _blocks('<pre>漢字</pre>')), isNull);
+    });
+
+    test('writes lists with their markers', () async {
+      final blocks = await _blocks(
+          '<ol><li>first</li><li>second</li></ol><ul><li>item</li></ul>');
+      expect(await PdfTextWriter().write(blocks), isNotEmpty);
+    });
+
+    test('breaks pages and stops at maxPages', () async {
+      final blocks = await _blocks('<p>line</p>' * 200);
+      await expectLater(PdfTextWriter(maxPages: 1).write(blocks),
+          throwsA(isA<TooManyPagesException>()));
+      expect(await PdfTextWriter(maxPages: 10).write(blocks), isNotEmpty);
+    });
+
+    test('starts a new line at <br>', () async {
+      final spaces = await _blocks('<p>${'word ' * 100}</p>');
+      final breaks = await _blocks('<p>${'word<br>' * 100}</p>');
+      expect(await PdfTextWriter(maxPages: 1).write(spaces), isNotEmpty);
+      await expectLater(PdfTextWriter(maxPages: 1).write(breaks),
+          throwsA(isA<TooManyPagesException>()));
+    });
+
+    test('hyphenates words wider than a line', () async {
+      final hyphenator =
+          HtmlHyphenator.fromPatterns('1x', leftMin: 1, rightMin: 1);
+      final blocks = await _blocks('<p>${'x' * 500}</p>');
+      final writer = PdfTextWriter(hyphenator: hyphenator);
+      expect(await writer.write(blocks), isNotEmpty);
+    });
+
+    test('reuses the layout of repeated blocks', () async {
+      final cache = TextLayoutCache.instance..clear();
+      final blocks = await _blocks('<p>Thank you for your <b>order</b>.</p>');
+      await PdfTextWriter().write(blocks);
+      expect(cache.misses, 1);
+      expect(cache.hits, 0);
+
+      await PdfTextWriter().write(blocks);
+      expect(cache.misses, 1);
+      expect(cache.hits, 1);
+      cache.clear();
+    });
+  });
+}